@@ -0,0 +1,766 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_compact.h"
+#include "../obs_ptr/obs_graph.h"
+#include "../obs_ptr/obs_map.h"
+#include "../obs_ptr/obs_pool.h"
+#include "../obs_ptr/obs_ptr.h"
+#include "../obs_ptr/obs_shared.h"
+#include "../obs_ptr/obs_vector.h"
+#include <benchmark/benchmark.h>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/polymorphic.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+// ========================
+// Allocation counting
+// ========================
+// Every benchmark reports allocs/op next to its time, counted by replacing the global allocation functions.
+namespace
+{
+std::atomic<std::size_t> g_allocations{0};
+
+class AllocationCounter
+{
+public:
+    void start()
+    {
+        m_start = g_allocations.load(std::memory_order_relaxed);
+    }
+
+    void stop()
+    {
+        m_total += g_allocations.load(std::memory_order_relaxed) - m_start;
+    }
+
+    void report(benchmark::State &state) const
+    {
+        state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(m_total), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    std::size_t m_start = 0;
+    std::size_t m_total = 0;
+};
+} // namespace
+
+namespace
+{
+// Kept out of line, so the compiler never pairs a replaced operator delete with the malloc behind operator new
+[[gnu::noinline]] void *counted_allocate(std::size_t size, std::size_t alignment) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size ? size : 1;
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        return std::malloc(size);
+    }
+    // aligned_alloc needs a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *counted_allocate_or_throw(std::size_t size, std::size_t alignment)
+{
+    if (void *p = counted_allocate(size, alignment))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void counted_free(void *p) noexcept
+{
+    std::free(p);
+}
+} // namespace
+
+// Every replaceable form, so aligned and nothrow allocations are counted too
+
+void *operator new(std::size_t size)
+{
+    return counted_allocate_or_throw(size, 0);
+}
+
+void *operator new[](std::size_t size)
+{
+    return counted_allocate_or_throw(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, 0);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    counted_free(p);
+}
+
+// ========================
+// Fixtures
+// ========================
+namespace
+{
+class BenchTarget : public IObserved
+{
+    int a = 1;
+
+public:
+    template <class Archive>
+    void save(Archive &ar) const
+    {
+        ar(cereal::base_class<IObserved>(this), a);
+    }
+
+    template <class Archive>
+    void load(Archive &ar)
+    {
+        ar(cereal::base_class<IObserved>(this), a);
+    }
+};
+
+// A target with a number of observers already registered, the registry size the operation runs against
+struct ObservedTarget
+{
+    explicit ObservedTarget(std::size_t observers)
+        : spTarget(std::make_shared<BenchTarget>()), background(observers, obs_ptr<BenchTarget>(spTarget))
+    {
+    }
+
+    std::shared_ptr<BenchTarget> spTarget;
+    std::vector<obs_ptr<BenchTarget>> background;
+};
+
+void ObserverCounts(benchmark::internal::Benchmark *b)
+{
+    b->Arg(1)->Arg(16)->Arg(1 << 10)->Arg(1 << 20);
+}
+} // namespace
+
+// ========================
+// Attach / detach
+// ========================
+static void BM_MakeObserver(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        auto spObserver = make_observer(target.spTarget);
+        benchmark::DoNotOptimize(spObserver);
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_MakeObserver)->Apply(ObserverCounts);
+
+static void BM_MakeObserverPooled(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    obs_pool pool(obs_pool::node_size<obs_ptr<BenchTarget>>);
+    std::pmr::polymorphic_allocator<> alloc(&pool);
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        auto spObserver = make_observer(alloc, target.spTarget);
+        benchmark::DoNotOptimize(spObserver);
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_MakeObserverPooled)->Apply(ObserverCounts);
+
+// Fan-out of N new observers onto a fresh target, one make_observer at a time or in bulk
+static void BM_FanOutLoop(benchmark::State &state)
+{
+    const auto count = static_cast<std::size_t>(state.range(0));
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        auto spTarget = std::make_shared<BenchTarget>();
+        std::vector<obs_sptr<BenchTarget>> observers;
+        observers.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            observers.push_back(make_observer(spTarget));
+        }
+        benchmark::DoNotOptimize(observers.data());
+    }
+    allocs.stop();
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutLoop)->Apply(ObserverCounts);
+
+static void BM_FanOutObserveAll(benchmark::State &state)
+{
+    const auto count = static_cast<std::size_t>(state.range(0));
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        auto spTarget = std::make_shared<BenchTarget>();
+        auto observers = observe_all(spTarget, count);
+        benchmark::DoNotOptimize(observers.data());
+    }
+    allocs.stop();
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FanOutObserveAll)->Apply(ObserverCounts);
+
+static void BM_SetUnset(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    obs_ptr<BenchTarget> observer;
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        observer.set(target.spTarget);
+        observer.unset();
+        benchmark::ClobberMemory();
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_SetUnset)->Apply(ObserverCounts);
+
+static void BM_CopyObserver(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    auto spObserver = make_observer(target.spTarget);
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        auto spCopy = copy_observer(spObserver);
+        benchmark::DoNotOptimize(spCopy);
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_CopyObserver)->Apply(ObserverCounts);
+
+static void BM_MoveObserver(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    auto spObserver = make_observer(target.spTarget);
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        spObserver = move_observer(spObserver);
+        benchmark::DoNotOptimize(spObserver);
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_MoveObserver)->Apply(ObserverCounts);
+
+// ========================
+// Queries
+// ========================
+static void BM_CompareEqual(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    obs_ptr<BenchTarget> observer(target.spTarget);
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(observer == target.spTarget);
+        benchmark::DoNotOptimize(observer == target.background.front());
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_CompareEqual)->Apply(ObserverCounts);
+
+static void BM_IsSet(benchmark::State &state)
+{
+    ObservedTarget target(state.range(0));
+    obs_ptr<BenchTarget> observer(target.spTarget);
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(observer.is_set());
+    }
+    allocs.stop();
+    allocs.report(state);
+}
+BENCHMARK(BM_IsSet)->Apply(ObserverCounts);
+
+// Visiting the live half of N observed targets: a vector of obs_sptr filtered with is_set, versus obs_vector
+static void BM_ScanSptrVector(benchmark::State &state)
+{
+    std::vector<std::shared_ptr<BenchTarget>> targets;
+    std::vector<obs_sptr<BenchTarget>> observers;
+    for (std::int64_t i = 0; i < state.range(0); ++i)
+    {
+        auto spTarget = std::make_shared<BenchTarget>();
+        observers.push_back(make_observer(spTarget));
+        if (i % 2 == 0)
+        {
+            targets.push_back(std::move(spTarget));
+        }
+    }
+    for (auto _ : state)
+    {
+        int sum = 0;
+        for (auto &spObserver : observers)
+        {
+            if (spObserver->is_set())
+            {
+                benchmark::DoNotOptimize(spObserver->get());
+                sum++;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScanSptrVector)->Apply(ObserverCounts);
+
+static void BM_ScanObsVector(benchmark::State &state)
+{
+    std::vector<std::shared_ptr<BenchTarget>> targets;
+    obs_vector<BenchTarget> observers;
+    for (std::int64_t i = 0; i < state.range(0); ++i)
+    {
+        auto spTarget = std::make_shared<BenchTarget>();
+        observers.push_back(spTarget);
+        if (i % 2 == 0)
+        {
+            targets.push_back(std::move(spTarget));
+        }
+    }
+    for (auto _ : state)
+    {
+        int sum = 0;
+        for (auto &target : observers)
+        {
+            benchmark::DoNotOptimize(&target);
+            sum++;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScanObsVector)->Apply(ObserverCounts);
+
+// Scanning an array of N observers of which half lost their target: obs_ptr versus obs_compact_ptr
+template <class Observer>
+static void ScanObserverArray(benchmark::State &state)
+{
+    std::vector<std::shared_ptr<BenchTarget>> targets;
+    std::vector<Observer> observers;
+    observers.reserve(state.range(0));
+    for (std::int64_t i = 0; i < state.range(0); ++i)
+    {
+        auto spTarget = std::make_shared<BenchTarget>();
+        observers.emplace_back(spTarget);
+        if (i % 2 == 0)
+        {
+            targets.push_back(std::move(spTarget));
+        }
+    }
+    for (auto _ : state)
+    {
+        int sum = 0;
+        for (auto &observer : observers)
+        {
+            sum += observer.is_set();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.counters["bytes/observer"] = sizeof(Observer);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_ScanObsPtrArray(benchmark::State &state)
+{
+    ScanObserverArray<obs_ptr<BenchTarget>>(state);
+}
+BENCHMARK(BM_ScanObsPtrArray)->Apply(ObserverCounts);
+
+static void BM_ScanCompactArray(benchmark::State &state)
+{
+    ScanObserverArray<obs_compact_ptr<BenchTarget>>(state);
+}
+BENCHMARK(BM_ScanCompactArray)->Apply(ObserverCounts);
+
+// Memoizing a value per target: a map entry paired with an erasing make_observer callback, versus obs_map.
+// Fills the map for N live targets and clears it again.
+static void BM_MemoMakeObserver(benchmark::State &state)
+{
+    using observer_type = obs_ptr<BenchTarget, std::function<void()>>;
+    std::vector<std::shared_ptr<BenchTarget>> targets(state.range(0));
+    for (auto &spTarget : targets)
+    {
+        spTarget = std::make_shared<BenchTarget>();
+    }
+    std::unordered_map<const BenchTarget *, std::pair<int, std::shared_ptr<observer_type>>> memo;
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        for (auto &spTarget : targets)
+        {
+            const BenchTarget *pKey = spTarget.get();
+            memo.try_emplace(pKey, 1, make_observer<BenchTarget, std::function<void()>>(spTarget, [&memo, pKey]
+                                                                                          { memo.erase(pKey); }));
+        }
+        memo.clear();
+    }
+    allocs.stop();
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemoMakeObserver)->Apply(ObserverCounts);
+
+static void BM_MemoObsMap(benchmark::State &state)
+{
+    std::vector<std::shared_ptr<BenchTarget>> targets(state.range(0));
+    for (auto &spTarget : targets)
+    {
+        spTarget = std::make_shared<BenchTarget>();
+    }
+    obs_map<BenchTarget, int> memo;
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        for (auto &spTarget : targets)
+        {
+            memo.try_emplace(spTarget, 1);
+        }
+        memo.clear();
+    }
+    allocs.stop();
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemoObsMap)->Apply(ObserverCounts);
+
+// One hot target read from many threads, through a pin versus through a locked weak_ptr
+static std::shared_ptr<BenchTarget> g_spHotTarget = make_observed<BenchTarget>();
+static obs_ptr<BenchTarget> g_hotObserver(g_spHotTarget);
+
+static void BM_PinHotTarget(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        auto pin = g_hotObserver.pin();
+        benchmark::DoNotOptimize(pin.get());
+    }
+}
+BENCHMARK(BM_PinHotTarget)->ThreadRange(1, 64);
+
+static void BM_LockHotTarget(benchmark::State &state)
+{
+    auto wpTarget = g_hotObserver.get_as_weak();
+    for (auto _ : state)
+    {
+        auto spTarget = wpTarget.lock();
+        benchmark::DoNotOptimize(spTarget.get());
+    }
+}
+BENCHMARK(BM_LockHotTarget)->ThreadRange(1, 64);
+
+// ========================
+// Destruction fan-out
+// ========================
+// Times ~IObserved only, which runs notify_all over every registered observer
+static void BM_NotifyAll(benchmark::State &state)
+{
+    const auto observers = static_cast<std::size_t>(state.range(0));
+    std::vector<obs_ptr<BenchTarget>> background;
+    background.reserve(observers);
+    AllocationCounter allocs;
+    for (auto _ : state)
+    {
+        auto spTarget = std::make_shared<BenchTarget>();
+        for (std::size_t i = 0; i < observers; ++i)
+        {
+            background.emplace_back(spTarget);
+        }
+
+        allocs.start();
+        auto start = std::chrono::steady_clock::now();
+        spTarget.reset();
+        auto end = std::chrono::steady_clock::now();
+        allocs.stop();
+
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+        background.clear();
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NotifyAll)->Apply(ObserverCounts)->UseManualTime();
+
+// Destroying a target whose observation was handed to N holders: N copied observers versus N shared handles
+static void BM_NotifyCopies(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto spTarget = std::make_shared<BenchTarget>();
+        auto spObserver = make_observer(spTarget);
+        std::vector<obs_sptr<BenchTarget>> holders;
+        for (std::int64_t i = 0; i < state.range(0); ++i)
+        {
+            holders.push_back(copy_observer(spObserver));
+        }
+        state.ResumeTiming();
+        spTarget.reset();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NotifyCopies)->Arg(16)->Arg(1 << 10);
+
+static void BM_NotifyShared(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto spTarget = std::make_shared<BenchTarget>();
+        auto spObserver = make_observer(spTarget);
+        std::vector<obs_shared<BenchTarget>> holders(state.range(0), share_observer(spObserver));
+        state.ResumeTiming();
+        spTarget.reset();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NotifyShared)->Arg(16)->Arg(1 << 10);
+
+// ========================
+// Serialization
+// ========================
+namespace
+{
+struct SerializedGraph
+{
+    explicit SerializedGraph(std::size_t observers)
+        : spTarget(std::make_shared<BenchTarget>())
+    {
+        spObservers.reserve(observers);
+        for (std::size_t i = 0; i < observers; ++i)
+        {
+            spObservers.push_back(make_observer(spTarget));
+        }
+    }
+
+    void save(std::ostream &os) const
+    {
+        cereal::BinaryOutputArchive archive{os};
+        archive(spTarget);
+        for (auto &spObserver : spObservers)
+        {
+            archive(spObserver);
+        }
+    }
+
+    void load(std::istream &is)
+    {
+        cereal::BinaryInputArchive archive{is};
+        archive(spTarget);
+        for (auto &spObserver : spObservers)
+        {
+            archive(spObserver);
+        }
+    }
+
+    std::shared_ptr<BenchTarget> spTarget;
+    std::vector<obs_sptr<BenchTarget>> spObservers;
+};
+} // namespace
+
+static void BM_CerealSave(benchmark::State &state)
+{
+    SerializedGraph graph(state.range(0));
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        std::stringstream ss;
+        graph.save(ss);
+        benchmark::DoNotOptimize(ss);
+    }
+    allocs.stop();
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CerealSave)->Apply(ObserverCounts);
+
+static void BM_CerealLoad(benchmark::State &state)
+{
+    SerializedGraph graph(state.range(0));
+    std::stringstream saved;
+    graph.save(saved);
+    const std::string bytes = saved.str();
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        std::stringstream ss(bytes);
+        graph.load(ss);
+    }
+    allocs.stop();
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CerealLoad)->Apply(ObserverCounts);
+
+// Same graph in the edge-list format, through a temporary file
+static void BM_GraphSave(benchmark::State &state)
+{
+    SerializedGraph graph(state.range(0));
+    std::FILE *pFile = std::tmpfile();
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        lseek(fileno(pFile), 0, SEEK_SET);
+        obs_graph_writer writer(fileno(pFile));
+        writer.add_target(*graph.spTarget, 0);
+        for (auto &spObserver : graph.spObservers)
+        {
+            writer.add_observer(*spObserver);
+        }
+        writer.finish();
+    }
+    allocs.stop();
+    allocs.report(state);
+    std::fclose(pFile);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GraphSave)->Apply(ObserverCounts);
+
+static void BM_GraphLoad(benchmark::State &state)
+{
+    SerializedGraph graph(state.range(0));
+    std::FILE *pFile = std::tmpfile();
+    {
+        obs_graph_writer writer(fileno(pFile));
+        writer.add_target(*graph.spTarget, 0);
+        for (auto &spObserver : graph.spObservers)
+        {
+            writer.add_observer(*spObserver);
+        }
+        writer.finish();
+    }
+    AllocationCounter allocs;
+    allocs.start();
+    for (auto _ : state)
+    {
+        lseek(fileno(pFile), 0, SEEK_SET);
+        obs_graph_reader reader(fileno(pFile));
+        std::vector<std::shared_ptr<BenchTarget>> targets{std::make_shared<BenchTarget>()};
+        reader.target_ids();
+        for (auto &spObserver : graph.spObservers)
+        {
+            reader.relink(*spObserver, [&targets](std::uint32_t index)
+                          { return targets[index]; });
+        }
+    }
+    allocs.stop();
+    allocs.report(state);
+    std::fclose(pFile);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GraphLoad)->Apply(ObserverCounts);
+
+BENCHMARK_MAIN();
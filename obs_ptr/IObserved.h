@@ -3,21 +3,22 @@
 // ========================
 // Standard Library Includes
 // ========================
-#include <set>
 #include <algorithm>
+#include <vector>
 #include <memory>
+#include <memory_resource>
+#include <thread>
 #include <cassert>
-
-// ========================
-// Third-Party Library Includes
-// ========================
-#include <cereal/types/vector.hpp>
-#include <cereal/types/memory.hpp>
+#include <cstdint>
 
 // ========================
 // Local Project Includes
 // ========================
 #include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_metrics.h"
+#include "obs_sync.h"
+#include "obs_trace.h"
 
 // ========================
 // Namespace Usings
@@ -28,107 +29,427 @@
 // ========================
 class IObserver;
 
+namespace obs_detail
+{
+template <class T>
+struct hazard_deleter;
+}
+
+namespace obs_detail
+{
+// Registry of a target with more than one observer, or with its own memory resource. Each observer keeps its own
+// index into observers (see IObserver), so attach, detach and membership checks are O(1).
+struct alignas(8) registry_block
+{
+    registry_block(std::pmr::memory_resource *pResource, bool pinned)
+        : observers(pResource), pinned(pinned)
+    {
+    }
+
+    std::pmr::vector<observer_record> observers;
+    // Kept while the target lives even without observers, because it holds the target's memory resource
+    bool pinned;
+};
+} // namespace obs_detail
+
 class IObserved
 {
-    std::vector<std::weak_ptr<IObserver>> m_observers; // Cannot have duplicate values
+    // The whole registry state is one word. Most targets are never observed and pay for nothing else:
+    //   bit 0  lock, guards the registry and the back-link indices in thread-safe mode
+    //   bit 1  dying, set once destruction starts; the registry is closed to new observers from then on
+    //   bit 2  the pointer is a registry_block, otherwise it is the only observer, stored inline
+    // The remaining bits are the pointer, null without observers. The block is allocated when a second observer
+    // attaches and released when the last one leaves. Lock order is observer (hook_guard) before registry;
+    // notify_all only ever try-locks an observer.
+    static constexpr std::uintptr_t dying_bit = 2;
+    static constexpr std::uintptr_t block_bit = 4;
+    static constexpr std::uintptr_t tag_mask = 7;
+    static_assert(alignof(IObserver) > tag_mask && alignof(obs_detail::registry_block) > tag_mask);
+
+    mutable obs_detail::word_type m_word;
+    // Largest registry size so far, only tracked with OBS_PTR_METRICS
+    [[no_unique_address]] obs_detail::observer_peak<> m_peakObservers;
+
+    // Holds the registry lock. word() is the unlocked state, written back on release.
+    class registry_guard
+    {
+    public:
+        explicit registry_guard(const IObserved &observed) noexcept
+            : m_observed(observed), m_word(observed.lock_word())
+        {
+        }
+
+        ~registry_guard()
+        {
+            m_observed.unlock_word(m_word);
+        }
+
+        registry_guard(const registry_guard &) = delete;
+        registry_guard &operator=(const registry_guard &) = delete;
+
+        std::uintptr_t &word() noexcept
+        {
+            return m_word;
+        }
+
+    private:
+        const IObserved &m_observed;
+        std::uintptr_t m_word;
+    };
+
+    std::uintptr_t lock_word() const noexcept
+    {
+        return m_word.lock();
+    }
+
+    // A dying target may be freed right after another thread unlocks it, which touches it no more
+    void unlock_word(std::uintptr_t word) const noexcept
+    {
+        m_word.unlock(word);
+    }
+
+    static bool has_block(std::uintptr_t word) noexcept
+    {
+        return (word & block_bit) != 0;
+    }
+
+    static obs_detail::registry_block *block_of(std::uintptr_t word) noexcept
+    {
+        return reinterpret_cast<obs_detail::registry_block *>(word & ~tag_mask);
+    }
+
+    static IObserver *inline_observer(std::uintptr_t word) noexcept
+    {
+        return reinterpret_cast<IObserver *>(word & ~tag_mask);
+    }
+
+    static std::size_t size_of(std::uintptr_t word) noexcept
+    {
+        if (has_block(word))
+        {
+            return block_of(word)->observers.size();
+        }
+        return inline_observer(word) != nullptr ? 1 : 0;
+    }
+
+    static std::uintptr_t with_pointer(std::uintptr_t word, const void *p, std::uintptr_t tag = 0) noexcept
+    {
+        return (word & dying_bit) | reinterpret_cast<std::uintptr_t>(p) | tag;
+    }
+
+    static obs_detail::registry_block *new_block(std::pmr::memory_resource *pResource, bool pinned)
+    {
+        std::pmr::polymorphic_allocator<> alloc(pResource);
+        return alloc.new_object<obs_detail::registry_block>(pResource, pinned);
+    }
+
+    static void delete_block(obs_detail::registry_block *pBlock) noexcept
+    {
+        std::pmr::polymorphic_allocator<> alloc(pBlock->observers.get_allocator().resource());
+        alloc.delete_object(pBlock);
+    }
+
     void notify_all()
     {
-        // All_observers is unchanging, containing all the observers at the start of destruction
-        // Since some MemObservers are owned by other objects (e.g. vectors), the handling of one notification may impact others
-        // We therefore compare if the pointer in all_observers still exists in observers before sending another notification.
-        // This avoids sending notifications to destroyed objects, i.e. segfaults.
-        auto all_observers = m_observers;
-        for (auto wpObserver : all_observers)
+        // Observers are unlinked one at a time before being notified. Handling a notification may destroy
+        // or detach other observers (e.g. observers owned by the notified observer's owner), which unlinks
+        // them from the registry as well, so we never touch an observer that is no longer registered.
+        // No snapshot is taken: tearing down allocates nothing and visits each registered observer once.
+        // Targets destroyed by the callbacks only null their observers and queue the notifications on the
+        // cascade worklist, which the outermost teardown drains after each of its own notifications.
+        notification_batch *pBatch = notification_batch::active();
+        std::size_t observers;
         {
-            auto pObserver = wpObserver.lock();
-            if (pObserver == nullptr)
+            registry_guard guard(*this);
+            if ((guard.word() & dying_bit) != 0)
+            {
+                // Already torn down early (see make_observed), nothing can have registered since
+                return;
+            }
+            guard.word() |= dying_bit;
+            observers = size_of(guard.word());
+        }
+        obs_trace::notify_all(this, observers);
+        obs_metrics::teardown_timer timer(m_peakObservers);
+        notification_batch::cascade_scope cascade;
+        for (;;)
+        {
+            std::uintptr_t word = lock_word();
+            obs_detail::observer_record record;
+            if (has_block(word))
+            {
+                auto pBlock = block_of(word);
+                if (pBlock->observers.empty())
+                {
+                    delete_block(pBlock);
+                    unlock_word(dying_bit);
+                    break;
+                }
+                record = pBlock->observers.back();
+            }
+            else if (IObserver *pInline = inline_observer(word))
+            {
+                record = {pInline, &IObserver::notify_virtual};
+            }
+            else
+            {
+                unlock_word(word);
+                break;
+            }
+
+            IObserver *pObserver = record.pObserver;
+            if (!pObserver->m_hookLock.try_lock())
+            {
+                // The observer is being detached or moved on another thread, which needs our lock to finish
+                unlock_word(word);
+                std::this_thread::yield();
+                continue;
+            }
+            if (has_block(word))
+            {
+                auto &records = block_of(word)->observers;
+                records.pop_back();
+                if (!records.empty())
+                {
+                    // Observers are scattered, start fetching the next one while this one is notified
+                    obs_detail::prefetch(records.back().pObserver);
+                }
+            }
+            else
+            {
+                word = dying_bit;
+            }
+            pObserver->m_pObservedLink.store(nullptr);
+            unlock_word(word);
+            obs_metrics::count_notification();
+
+            if (pBatch != nullptr)
+            {
+                // Nulling is immediate, the callback is dispatched when the batch ends
+                record.pNotify(*pObserver, true);
+                pBatch->defer(record);
+                pObserver->m_hookLock.unlock();
+            }
+            else
             {
-                // Should never happen under any circumstances. Observer was deallocated without notifying observed.
-                assert(false);
+                // Keeps the observer locked while it is notified, so other threads cannot destroy it mid-callback
+                IObserver::notify_locked(record);
+                cascade.drain();
             }
-            pObserver->handle_notification();
         }
+        obs_trace::notify_done(this);
     }
-    void add_observer(std::shared_ptr<IObserver> spObserver)
+
+    // The observer must hold its hook_guard for the following functions
+
+    // Returns false, leaving the observer unlinked, if this object is already being destroyed.
+    // A callback copying an observer of the dying object therefore gets an unset copy.
+    template <class Observer>
+    bool add_observer(Observer &observer)
     {
-        m_observers.push_back(spObserver);
+        return add_observers(&observer, 1);
     }
 
-    void remove_observer(std::shared_ptr<IObserver> spObserver)
+    // Registers count contiguous observers in one pass under one lock, growing the registry at most once.
+    // Returns false, leaving all of them unlinked, if this object is already being destroyed.
+    template <class Observer>
+    bool add_observers(Observer *pFirst, std::size_t count)
     {
-        for (auto it = m_observers.begin(); it != m_observers.end();)
+        registry_guard guard(*this);
+        std::uintptr_t &word = guard.word();
+        if ((word & dying_bit) != 0)
+        {
+            return false;
+        }
+        const std::size_t size = size_of(word);
+        assert(size + count <= UINT32_MAX);
+        // A pinned block is kept even for a single observer, it holds the target's memory resource
+        if (size + count == 1 && !has_block(word))
+        {
+            pFirst->m_linkIndex = 0;
+            word = with_pointer(word, static_cast<IObserver *>(pFirst));
+        }
+        else if (count > 0)
         {
-            if (auto sp = it->lock())
+            // Nothing changes until nothing can throw anymore
+            auto pBlock = has_block(word) ? block_of(word) : nullptr;
+            const bool isNew = pBlock == nullptr;
+            if (isNew)
             {
-                if (sp == spObserver)
+                pBlock = new_block(std::pmr::get_default_resource(), false);
+            }
+            auto &records = pBlock->observers;
+            try
+            {
+                if (records.capacity() < size + count)
                 {
-                    it = m_observers.erase(it);
-                    return;
+                    records.reserve(std::max(size + count, 2 * records.capacity()));
                 }
-                else
+            }
+            catch (...)
+            {
+                if (isNew)
                 {
-                    ++it;
+                    delete_block(pBlock);
                 }
+                throw;
             }
-            else
+            if (IObserver *pInline = isNew ? inline_observer(word) : nullptr)
+            {
+                // Registered inline before its type was known here
+                records.push_back({pInline, &IObserver::notify_virtual});
+            }
+            for (std::size_t i = 0; i < count; ++i)
             {
-                // Remove expired weak_ptrs while we're here
-                it = m_observers.erase(it);
+                pFirst[i].m_linkIndex = static_cast<std::uint32_t>(records.size());
+                records.push_back(IObserver::make_record(pFirst[i]));
             }
+            if (isNew)
+            {
+                word = with_pointer(word, pBlock, block_bit);
+            }
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // An observer can only observe one object at a time
+            assert(pFirst[i].m_pObservedLink.load() == nullptr);
+            pFirst[i].m_pObservedLink.store(this);
+            obs_metrics::count_attach(size + i + 1);
+            obs_trace::attach(this, &pFirst[i], size + i + 1);
         }
+        m_peakObservers.update(size + count);
+        return true;
     }
 
-    void remove_destructed_observer()
+    void remove_observer(IObserver &observer)
     {
-        auto isExpired = [](const std::weak_ptr<IObserver> &wp)
+        registry_guard guard(*this);
+        std::uintptr_t &word = guard.word();
+        assert(observer.m_pObservedLink.load() == this);
+        std::size_t size = 0;
+        if (has_block(word))
         {
-            return wp.expired();
-        };
-
-        auto expiredCount = std::count_if(m_observers.begin(), m_observers.end(), isExpired);
-        if (expiredCount > 1)
+            auto pBlock = block_of(word);
+            auto &records = pBlock->observers;
+            assert(records[observer.m_linkIndex].pObserver == &observer);
+            // Swap the last observer into the vacated slot and fix up its back-link
+            const obs_detail::observer_record last = records.back();
+            records[observer.m_linkIndex] = last;
+            last.pObserver->m_linkIndex = observer.m_linkIndex;
+            records.pop_back();
+            size = records.size();
+            // A dying target releases its block itself, at the end of notify_all
+            if (size == 0 && !pBlock->pinned && (word & dying_bit) == 0)
+            {
+                delete_block(pBlock);
+                word = 0;
+            }
+        }
+        else
         {
-            throw std::runtime_error("More than one expired weak_ptr found");
+            assert(inline_observer(word) == &observer);
+            word &= dying_bit;
         }
+        observer.m_pObservedLink.store(nullptr);
+        obs_metrics::count_detach();
+        obs_trace::detach(this, &observer, size);
+    }
 
-        m_observers.erase(std::remove_if(m_observers.begin(), m_observers.end(), isExpired), m_observers.end());
+    // Moves a registration from one observer to another of the same type without changing the number of observers
+    void relocate_observer(IObserver &from, IObserver &to) noexcept
+    {
+        registry_guard guard(*this);
+        std::uintptr_t &word = guard.word();
+        assert(from.m_pObservedLink.load() == this);
+        assert(to.m_pObservedLink.load() == nullptr);
+        to.m_linkIndex = from.m_linkIndex;
+        if (has_block(word))
+        {
+            block_of(word)->observers[to.m_linkIndex].pObserver = &to;
+        }
+        else
+        {
+            assert(inline_observer(word) == &from);
+            word = with_pointer(word, &to);
+        }
+        to.m_pObservedLink.store(this);
+        from.m_pObservedLink.store(nullptr);
     }
 
 protected:
     virtual ~IObserved()
     {
         notify_all();
-        m_observers.clear();
     }
     // Protected so derived classes have access to an automatically instantiate the set.
     IObserved() = default;
 
+    // Registry storage comes from pResource, e.g. a per-frame arena or an obs_pool. The registry is then kept
+    // for the whole lifetime of the target.
+    explicit IObserved(std::pmr::memory_resource *pResource)
+        : m_word(reinterpret_cast<std::uintptr_t>(new_block(pResource, true)) | block_bit)
+    {
+    }
+
+    // Observers observe one particular object, so a copy starts without observers
+    IObserved(const IObserved &) noexcept
+    {
+    }
+
+    IObserved &operator=(const IObserved &) noexcept
+    {
+        return *this;
+    }
+
 public:
+    // Resource the registry is allocated from: the one given at construction, the default resource otherwise
+    std::pmr::memory_resource *observer_resource() const noexcept
+    {
+        registry_guard guard(*this);
+        if (has_block(guard.word()) && block_of(guard.word())->pinned)
+        {
+            return block_of(guard.word())->observers.get_allocator().resource();
+        }
+        return std::pmr::get_default_resource();
+    }
+
     size_t Observers() const
     {
-        return m_observers.size();
+        registry_guard guard(*this);
+        return size_of(guard.word());
     }
 
-    // https://stackoverflow.com/questions/12301916/how-can-you-efficiently-check-whether-two-stdweak-ptr-pointers-are-pointing-to
     bool IsObserver(const std::shared_ptr<IObserver> pObserver) const
     {
-        std::weak_ptr<IObserver> wpOtherObserver = pObserver;
-        return std::find_if(m_observers.begin(), m_observers.end(), [&wpOtherObserver](const std::weak_ptr<IObserver> &wpObserver)
-                            { return !wpOtherObserver.owner_before(wpObserver) && !wpObserver.owner_before(wpOtherObserver); }) != m_observers.end();
+        return pObserver != nullptr && pObserver->m_pObservedLink.load() == this;
     }
 
-    template <class T>
+    template <class T, class... Policies>
     friend class obs_ptr;
+    template <class T, class Callback>
+    friend class obs_handle_watch;
+    template <class T>
+    friend struct obs_detail::hazard_deleter;
+    friend class obs_detail::await_node;
+    template <class T>
+    friend class obs_detail::vector_node;
+    template <class Owner, class T, class V>
+    friend class obs_detail::keyed_node;
+    template <class T, class Callback>
+    friend class obs_detail::compact_node;
+    template <class T>
+    friend class obs_detail::shared_node;
 
+    // Observers are not part of the observed object's state. Each obs_ptr saves its target
+    // and registers itself again when loaded. Nothing is written, so archives saved before observers were
+    // back-linked, which stored the observer list here, cannot be loaded.
     template <class Archive>
-    void save(Archive &archive) const
+    void save(Archive &) const
     {
-        archive(m_observers);
     }
 
     template <class Archive>
-    void load(Archive &archive)
+    void load(Archive &)
     {
-        archive(m_observers);
     }
-};
\ No newline at end of file
+};
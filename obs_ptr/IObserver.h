@@ -1,11 +1,64 @@
 #pragma once
 
+// ========================
+// Standard Library Includes
+// ========================
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "obs_sync.h"
+
 class IObserved;
+class notification_batch;
+
+namespace obs_detail
+{
+class await_node;
+template <class T>
+class vector_node;
+template <class Owner, class T, class V>
+class keyed_node;
+template <class T, class Callback>
+class compact_node;
+template <class T>
+class shared_node;
+} // namespace obs_detail
+
+class IObserver;
+
+namespace obs_detail
+{
+// One registration: the observer and the function that notifies it. The function is generated per concrete
+// observer type when it registers and calls its handle_notification directly, so delivering a notification
+// loads no vtable. Called with deferred set when a notification_batch defers the notification instead, it calls
+// handle_unlinked.
+struct observer_record
+{
+    IObserver *pObserver = nullptr;
+    void (*pNotify)(IObserver &, bool deferred) = nullptr;
+};
+
+// Entry of an observer in an obs_mailbox. Kept in the observer itself, so posting never allocates.
+struct mail_node
+{
+    observer_record record;
+    mail_node *pNext = nullptr;
+    mail_node *pPrev = nullptr;
+};
+} // namespace obs_detail
 
-class IObserver
+// Aligned so IObserved can keep three tag bits in a pointer to an observer
+class alignas(8) IObserver
 {
 public:
     friend class IObserved;
+    friend class notification_batch;
+    friend class obs_detail::await_node;
 
     template <class Archive>
     void serialize(Archive &archive)
@@ -13,5 +66,214 @@ public:
     }
 
 protected:
+    IObserver() = default;
+
+    // Registrations are never copied. A copied observer registers itself with what it observes.
+    IObserver(const IObserver &) noexcept
+    {
+    }
+
+    IObserver &operator=(const IObserver &) noexcept
+    {
+        return *this;
+    }
+
+    // Overridden by every observer, which must mark it final and befriend IObserver. It is only ever called
+    // through the observer_record thunk of the observer's own type, never through the vtable.
     virtual void handle_notification() = 0;
-};
\ No newline at end of file
+
+    // Called with the hook lock held when the target is destroyed but a notification_batch defers
+    // handle_notification. The link is already null. Overridden by observers that keep a copy of the link.
+    virtual void handle_unlinked() noexcept
+    {
+    }
+
+    // Observed object this observer is registered with, or nullptr when unregistered.
+    // Maintained by IObserved only, which also nulls it on destruction.
+    IObserved *observed_link() const noexcept
+    {
+        return m_pObservedLink.load();
+    }
+
+    // Held while changing this observer's registration or its callback.
+    // In thread-safe mode a non-null link cannot be nulled (so the observed object cannot finish
+    // destruction) while the guard is held. Compiles to nothing in single-threaded mode.
+    // Destroying or moving from an observer passes waitIdle, to wait for its callbacks running on other threads.
+    class hook_guard
+    {
+    public:
+        explicit hook_guard(const IObserver &observer, bool waitIdle = false) noexcept
+        {
+            if constexpr (obs_detail::thread_safe)
+            {
+                auto pFrame = obs_detail::find_notification_frame(&observer);
+                if (pFrame != nullptr && !pFrame->unlocked)
+                {
+                    // The notifying thread already holds the lock of the observer it is notifying
+                    return;
+                }
+                m_pLock = &observer.m_hookLock;
+                m_pLock->lock();
+                // A callback running on this thread is not waited for, it is the one destroying or moving us
+                while (waitIdle && pFrame == nullptr && observer.m_busy.is_busy())
+                {
+                    m_pLock->unlock();
+                    std::this_thread::yield();
+                    m_pLock->lock();
+                }
+            }
+        }
+
+        ~hook_guard()
+        {
+            if (m_pLock != nullptr)
+            {
+                m_pLock->unlock();
+            }
+        }
+
+        hook_guard(const hook_guard &) = delete;
+        hook_guard &operator=(const hook_guard &) = delete;
+
+    private:
+        obs_detail::lock_type *m_pLock = nullptr;
+    };
+
+    // Called first by every observer's destructor, which then tears down under hook_guard(*this, true). False if
+    // the observer is destroyed by its own notification while that holds the lock: it is unlinked already and
+    // must not be touched again. Either way the notifying thread no longer touches it.
+    bool begin_teardown() noexcept
+    {
+        if constexpr (obs_detail::thread_safe)
+        {
+            if (auto pFrame = obs_detail::find_notification_frame(this))
+            {
+                pFrame->destroyed = true;
+                return pFrame->unlocked;
+            }
+        }
+        return true;
+    }
+
+    // Runs user code from handle_notification, such as a callback, without the hook lock. The code may then set,
+    // unset or move other observers, which take their own locks, while their callbacks run on other threads.
+    // Meanwhile this observer can be set, unset and assigned to from any thread, while destroying or moving from
+    // it waits for f. Returns false if f destroyed this observer, which must then not be touched again.
+    template <class F>
+    bool run_unlocked(F &&f)
+    {
+        if constexpr (obs_detail::thread_safe)
+        {
+            auto pFrame = obs_detail::find_notification_frame(this);
+            assert(pFrame != nullptr);
+            m_busy.enter();
+            pFrame->unlocked = true;
+            m_hookLock.unlock();
+            f();
+            if (pFrame->destroyed)
+            {
+                return false;
+            }
+            m_hookLock.lock();
+            pFrame->unlocked = false;
+            m_busy.leave();
+        }
+        else
+        {
+            f();
+        }
+        return true;
+    }
+
+    // Runs the callback held in cb through run_unlocked. In thread-safe mode it is taken out of cb while it runs,
+    // so that other threads may replace or clear cb meanwhile, and put back unless they did.
+    template <class Callback>
+    void invoke_callback(Callback &cb)
+    {
+        if constexpr (obs_detail::thread_safe)
+        {
+            Callback running = std::exchange(cb, {});
+            m_callbackChanged = false;
+            if (run_unlocked(running) && !m_callbackChanged && !cb)
+            {
+                cb = std::move(running);
+            }
+        }
+        else
+        {
+            cb();
+        }
+    }
+
+    // Requires the hook lock. Called whenever the callback is replaced or cleared, see invoke_callback.
+    void callback_changed() noexcept
+    {
+        m_callbackChanged = true;
+    }
+
+private:
+    template <class Observer>
+    static void notify_thunk(IObserver &observer, bool deferred)
+    {
+        if (deferred)
+        {
+            static_cast<Observer &>(observer).Observer::handle_unlinked();
+        }
+        else
+        {
+            static_cast<Observer &>(observer).Observer::handle_notification();
+        }
+    }
+
+    template <class Observer>
+    static obs_detail::observer_record make_record(Observer &observer) noexcept
+    {
+        return {&observer, &notify_thunk<Observer>};
+    }
+
+    // For an observer registered before its concrete type was known, see IObserved's inline observer
+    static void notify_virtual(IObserver &observer, bool deferred)
+    {
+        if (deferred)
+        {
+            observer.handle_unlinked();
+        }
+        else
+        {
+            observer.handle_notification();
+        }
+    }
+
+    // Delivers a notification to an observer whose hook lock the caller holds. The lock is released
+    // afterwards, unless handle_notification destroyed the observer.
+    static void notify_locked(const obs_detail::observer_record &record)
+    {
+        IObserver &observer = *record.pObserver;
+        if constexpr (obs_detail::thread_safe)
+        {
+            obs_detail::notification_frame frame{&observer, obs_detail::t_pNotificationFrame};
+            obs_detail::t_pNotificationFrame = &frame;
+            record.pNotify(observer, false);
+            obs_detail::t_pNotificationFrame = frame.pOuter;
+            if (!frame.destroyed)
+            {
+                observer.m_hookLock.unlock();
+            }
+        }
+        else
+        {
+            record.pNotify(observer, false);
+        }
+    }
+
+    // Back-link into the observed object's registry: m_observers[m_linkIndex].pObserver == this while linked.
+    // m_linkIndex is guarded by the registry lock of the observed object.
+    obs_detail::link_ptr<IObserved> m_pObservedLink;
+    // Batch holding a deferred notification for this observer, see notification_batch
+    notification_batch *m_pPendingBatch = nullptr;
+    std::uint32_t m_linkIndex = 0;
+    std::uint32_t m_pendingIndex = 0;
+    [[no_unique_address]] mutable obs_detail::lock_type m_hookLock;
+    [[no_unique_address]] obs_detail::busy_type m_busy;
+    bool m_callbackChanged = false;
+};
@@ -0,0 +1,380 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserver.h"
+#include "obs_metrics.h"
+#include "obs_sync.h"
+
+// RAII scope for bulk teardown. While a batch is active on a thread, every IObserved destroyed on that thread
+// still nulls its observers immediately, but their notifications (and callbacks) are collected instead of run.
+// When the outermost batch ends they are dispatched in one pass, ordered by observer address, and at most once
+// per observer no matter how many of its targets died in the meantime.
+//
+//     {
+//         notification_batch batch;
+//         level.clear(); // thousands of targets destroyed, no callbacks yet
+//     } // callbacks run here
+//
+// Nested batches join the outermost one. Observers destroyed or unset before dispatch are dropped from the batch.
+//
+// Without a batch, each thread has an implicit one for cascades: while a target notifies its observers, targets
+// destroyed by their callbacks defer their notifications to it, and the outermost teardown runs them first in,
+// first out after each of its own notifications. Destruction chains of any length thus run at constant stack depth.
+class notification_batch
+{
+public:
+    notification_batch() noexcept
+    {
+        if (t_pActive == nullptr)
+        {
+            t_pActive = this;
+        }
+    }
+
+    ~notification_batch()
+    {
+        if (t_pActive == this)
+        {
+            dispatch();
+            t_pActive = nullptr;
+        }
+        assert(m_pending.empty());
+    }
+
+    notification_batch(const notification_batch &) = delete;
+    notification_batch &operator=(const notification_batch &) = delete;
+
+    // Batch collecting notifications on the calling thread, if any
+    static notification_batch *active() noexcept
+    {
+        return t_pActive;
+    }
+
+    // Cascade worklist of the calling thread, active for the duration of its outermost teardown (see above)
+    class cascade_scope
+    {
+    public:
+        cascade_scope() noexcept
+            : m_pCascade(t_pActive == nullptr ? &cascade() : nullptr)
+        {
+            if (m_pCascade != nullptr)
+            {
+                t_pActive = m_pCascade;
+            }
+        }
+
+        ~cascade_scope()
+        {
+            if (m_pCascade != nullptr)
+            {
+                drain();
+                t_pActive = nullptr;
+            }
+        }
+
+        cascade_scope(const cascade_scope &) = delete;
+        cascade_scope &operator=(const cascade_scope &) = delete;
+
+        // Runs the notifications deferred by cascaded teardowns so far, including those they cascade into
+        void drain()
+        {
+            if (m_pCascade != nullptr && !m_pCascade->m_pending.empty())
+            {
+                m_pCascade->dispatch();
+            }
+        }
+
+    private:
+        notification_batch *m_pCascade;
+    };
+
+    // Number of observers with a deferred notification
+    std::size_t pending() const
+    {
+        std::lock_guard lock(m_lock);
+        return m_pending.size() - m_cancelled;
+    }
+
+    template <class T, class... Policies>
+    friend class obs_ptr;
+    template <class T, class Callback>
+    friend class obs_handle_watch;
+    friend class IObserved;
+    friend class obs_detail::await_node;
+    template <class T>
+    friend class obs_detail::vector_node;
+    template <class Owner, class T, class V>
+    friend class obs_detail::keyed_node;
+    template <class T, class Callback>
+    friend class obs_detail::compact_node;
+    template <class T>
+    friend class obs_detail::shared_node;
+    friend class obs_mailbox;
+
+private:
+    // A scope batch dispatches in address order. The cascade worklist and mailboxes keep arrival order.
+    enum class kind : std::uint8_t
+    {
+        scope,
+        cascade,
+        mailbox
+    };
+
+    struct cascade_tag
+    {
+    };
+
+    struct mailbox_tag
+    {
+    };
+
+    explicit notification_batch(cascade_tag) noexcept
+        : m_kind(kind::cascade)
+    {
+    }
+
+    explicit notification_batch(mailbox_tag) noexcept
+        : m_kind(kind::mailbox)
+    {
+    }
+
+    static notification_batch &cascade() noexcept
+    {
+        static thread_local notification_batch t_cascade(cascade_tag{});
+        return t_cascade;
+    }
+
+    // Called by the dying IObserved with the observer's hook lock held
+    void defer(const obs_detail::observer_record &record)
+    {
+        IObserver &observer = *record.pObserver;
+        if (observer.m_pPendingBatch != nullptr)
+        {
+            // Already has a notification pending, one callback covers all its dead targets
+            return;
+        }
+        if (m_kind == kind::scope)
+        {
+            obs_metrics::count_deferred();
+        }
+        std::lock_guard lock(m_lock);
+        assert(m_pending.size() < UINT32_MAX);
+        observer.m_pPendingBatch = this;
+        observer.m_pendingIndex = static_cast<std::uint32_t>(m_pending.size());
+        m_pending.push_back(record);
+    }
+
+    // The following require the observer's hook lock
+
+    // Posts to a mailbox from any thread, without taking its lock or allocating: mail is part of the observer
+    template <class Observer>
+    void post(Observer &observer, obs_detail::mail_node &mail) noexcept
+    {
+        if (observer.m_pPendingBatch != nullptr)
+        {
+            return;
+        }
+        mail.record = IObserver::make_record(observer);
+        mail.pNext = m_pInbox.load(std::memory_order_relaxed);
+        observer.m_pPendingBatch = this;
+        while (!m_pInbox.compare_exchange_weak(mail.pNext, &mail, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Drops the pending notification of an observer that is destroyed or unset. pMail is the observer's mail
+    // node, needed if it may be posted to a mailbox.
+    static void cancel(IObserver &observer, obs_detail::mail_node *pMail = nullptr) noexcept
+    {
+        if (auto pBatch = observer.m_pPendingBatch)
+        {
+            std::lock_guard lock(pBatch->m_lock);
+            if (pBatch->m_kind == kind::mailbox)
+            {
+                assert(pMail != nullptr);
+                pBatch->collect_inbox();
+                pBatch->unlink_mail(*pMail);
+            }
+            else
+            {
+                pBatch->m_pending[observer.m_pendingIndex].pObserver = nullptr;
+                pBatch->m_cancelled++;
+            }
+            observer.m_pPendingBatch = nullptr;
+        }
+    }
+
+    // Moves the pending notification along with a moved observer, and its mail node if it is posted
+    static void relocate(IObserver &from, IObserver &to, obs_detail::mail_node *pFromMail = nullptr,
+                         obs_detail::mail_node *pToMail = nullptr) noexcept
+    {
+        if (auto pBatch = from.m_pPendingBatch)
+        {
+            std::lock_guard lock(pBatch->m_lock);
+            if (pBatch->m_kind == kind::mailbox)
+            {
+                assert(pFromMail != nullptr && pToMail != nullptr);
+                pBatch->collect_inbox();
+                pBatch->replace_mail(*pFromMail, *pToMail, to);
+            }
+            else
+            {
+                pBatch->m_pending[from.m_pendingIndex].pObserver = &to;
+                to.m_pendingIndex = from.m_pendingIndex;
+            }
+            to.m_pPendingBatch = pBatch;
+            from.m_pPendingBatch = nullptr;
+        }
+    }
+
+    // Mailbox only, with m_lock held. Appends the posted mail to the collected queue in the order it was posted.
+    // Every observer in the inbox is still alive: destroying or moving it needs m_lock to take its mail out.
+    void collect_inbox() noexcept
+    {
+        obs_detail::mail_node *pMail = m_pInbox.exchange(nullptr, std::memory_order_acquire);
+        // The inbox is a stack, newest first
+        obs_detail::mail_node *pOldest = nullptr;
+        while (pMail != nullptr)
+        {
+            obs_detail::mail_node *pNext = pMail->pNext;
+            pMail->pNext = pOldest;
+            pOldest = pMail;
+            pMail = pNext;
+        }
+        for (; pOldest != nullptr; pOldest = pOldest->pNext)
+        {
+            pOldest->pPrev = m_pLastMail;
+            (m_pLastMail != nullptr ? m_pLastMail->pNext : m_pFirstMail) = pOldest;
+            m_pLastMail = pOldest;
+        }
+    }
+
+    // Mailbox only, with m_lock held
+    void unlink_mail(obs_detail::mail_node &mail) noexcept
+    {
+        (mail.pPrev != nullptr ? mail.pPrev->pNext : m_pFirstMail) = mail.pNext;
+        (mail.pNext != nullptr ? mail.pNext->pPrev : m_pLastMail) = mail.pPrev;
+        mail.pPrev = mail.pNext = nullptr;
+    }
+
+    // Mailbox only, with m_lock held. Puts to's mail node in the queue in place of from's.
+    void replace_mail(obs_detail::mail_node &from, obs_detail::mail_node &to, IObserver &observer) noexcept
+    {
+        to.record = {&observer, from.record.pNotify};
+        to.pPrev = from.pPrev;
+        to.pNext = from.pNext;
+        (to.pPrev != nullptr ? to.pPrev->pNext : m_pFirstMail) = &to;
+        (to.pNext != nullptr ? to.pNext->pPrev : m_pLastMail) = &to;
+        from.pPrev = from.pNext = nullptr;
+    }
+
+    void dispatch()
+    {
+        // Callbacks may destroy more targets while we dispatch. Those are deferred into this batch as well
+        // and picked up by the next round.
+        std::size_t next = 0;
+        m_lock.lock();
+        while (next < m_pending.size())
+        {
+            if (m_kind == kind::scope)
+            {
+                // Visit observers in address order, cancelled (null) entries sort first. A cascade keeps the
+                // order its targets died in.
+                std::sort(m_pending.begin() + next, m_pending.end(), [](const obs_detail::observer_record &a, const obs_detail::observer_record &b)
+                          { return std::less<IObserver *>()(a.pObserver, b.pObserver); });
+                for (std::size_t i = next; i < m_pending.size(); ++i)
+                {
+                    if (m_pending[i].pObserver != nullptr)
+                    {
+                        m_pending[i].pObserver->m_pendingIndex = static_cast<std::uint32_t>(i);
+                    }
+                }
+            }
+
+            const std::size_t roundEnd = m_pending.size();
+            while (next < roundEnd)
+            {
+                const obs_detail::observer_record record = m_pending[next];
+                IObserver *pObserver = record.pObserver;
+                if (pObserver == nullptr)
+                {
+                    m_cancelled--;
+                    next++;
+                    continue;
+                }
+                if (!pObserver->m_hookLock.try_lock())
+                {
+                    // Being destroyed or moved on another thread, which needs our lock to finish
+                    m_lock.unlock();
+                    std::this_thread::yield();
+                    m_lock.lock();
+                    continue;
+                }
+                m_pending[next++].pObserver = nullptr;
+                pObserver->m_pPendingBatch = nullptr;
+                m_lock.unlock();
+                IObserver::notify_locked(record);
+                m_lock.lock();
+            }
+        }
+        m_pending.clear();
+        m_cancelled = 0;
+        m_lock.unlock();
+    }
+
+    // Mailbox only. Notifies the observers posted so far, first in first out. Returns how many were notified.
+    std::size_t dispatch_mail()
+    {
+        std::size_t notified = 0;
+        m_lock.lock();
+        collect_inbox();
+        while (m_pFirstMail != nullptr)
+        {
+            obs_detail::mail_node &mail = *m_pFirstMail;
+            const obs_detail::observer_record record = mail.record;
+            IObserver *pObserver = record.pObserver;
+            if (!pObserver->m_hookLock.try_lock())
+            {
+                // Being destroyed or moved on another thread, which needs our lock to take its mail out
+                m_lock.unlock();
+                std::this_thread::yield();
+                m_lock.lock();
+                continue;
+            }
+            unlink_mail(mail);
+            pObserver->m_pPendingBatch = nullptr;
+            m_lock.unlock();
+            IObserver::notify_locked(record);
+            notified++;
+            m_lock.lock();
+        }
+        m_lock.unlock();
+        return notified;
+    }
+
+    static inline thread_local notification_batch *t_pActive = nullptr;
+
+    // Observers with a deferred notification, each knows its own index. Cancelled entries are nulled, not erased.
+    std::vector<obs_detail::observer_record> m_pending;
+    std::size_t m_cancelled = 0;
+    mutable obs_detail::lock_type m_lock;
+    kind m_kind = kind::scope;
+    // Mailbox only. Mail posted by other threads, newest first, and mail collected from it under m_lock.
+    std::atomic<obs_detail::mail_node *> m_pInbox{nullptr};
+    obs_detail::mail_node *m_pFirstMail = nullptr;
+    obs_detail::mail_node *m_pLastMail = nullptr;
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_sync.h"
+
+// Resumes the awaiting coroutine right inside the destruction of the target, like a callback
+struct obs_inline_executor
+{
+    void operator()(std::coroutine_handle<> h) const
+    {
+        h.resume();
+    }
+};
+
+namespace obs_detail
+{
+class await_node;
+
+// Shared by the nodes of one co_await. Only the first target to die resumes the coroutine.
+class await_state
+{
+public:
+    static constexpr std::size_t none = SIZE_MAX;
+
+    void fire(std::size_t index)
+    {
+        std::size_t expected = none;
+        if (!m_winner.compare_exchange_strong(expected, index, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        if (m_phase.exchange(phase_fired, std::memory_order_acq_rel) == phase_suspended)
+        {
+            schedule(m_handle);
+        }
+    }
+
+    std::size_t winner() const noexcept
+    {
+        return m_winner.load(std::memory_order_acquire);
+    }
+
+protected:
+    ~await_state() = default;
+
+    // Returns false, so the coroutine is not suspended, if a target already died while registering
+    bool finish_suspend(std::coroutine_handle<> h) noexcept
+    {
+        m_handle = h;
+        int expected = phase_suspending;
+        return m_phase.compare_exchange_strong(expected, phase_suspended, std::memory_order_acq_rel);
+    }
+
+    void set_winner(std::size_t index) noexcept
+    {
+        m_winner.store(index, std::memory_order_relaxed);
+    }
+
+    virtual void schedule(std::coroutine_handle<> h) = 0;
+
+private:
+    static constexpr int phase_suspending = 0;
+    static constexpr int phase_suspended = 1;
+    static constexpr int phase_fired = 2;
+
+    std::atomic<std::size_t> m_winner{none};
+    std::atomic<int> m_phase{phase_suspending};
+    std::coroutine_handle<> m_handle;
+};
+
+// Observer registered on behalf of a suspended coroutine, lives in the coroutine frame
+class await_node : public IObserver
+{
+public:
+    await_node() = default;
+
+    await_node(const await_node &) = delete;
+    await_node &operator=(const await_node &) = delete;
+
+    ~await_node()
+    {
+        if (!begin_teardown())
+        {
+            return;
+        }
+        hook_guard guard(*this, true);
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        notification_batch::cancel(*this);
+    }
+
+    static bool is_linked(const IObserver &source) noexcept
+    {
+        return source.m_pObservedLink.load() != nullptr;
+    }
+
+    // Registers with the target of source. False if source is unset or its target is being destroyed.
+    bool attach(const IObserver &source, await_state &state, std::size_t index)
+    {
+        m_pState = &state;
+        m_index = index;
+        // source's lock keeps its target alive while we register
+        hook_guard guardSource(source);
+        hook_guard guard(*this);
+        auto pObserved = source.m_pObservedLink.load();
+        return pObserved != nullptr && pObserved->add_observer(*this);
+    }
+
+    friend class IObserver;
+
+protected:
+    void handle_notification() final
+    {
+        // May resume the coroutine inline, which destroys this node, so it must be the last thing we do
+        run_unlocked([this]()
+                     { m_pState->fire(m_index); });
+    }
+
+private:
+    await_state *m_pState = nullptr;
+    std::size_t m_index = 0;
+};
+} // namespace obs_detail
+
+// Awaitable returned by obs_ptr::destroyed() and obs_first_destroyed(). Suspends until the first of N observed
+// targets is destroyed, then resumes through executor, a callable taking std::coroutine_handle<>. Nothing is
+// polled or allocated: one observer node per target lives in the coroutine frame. co_await yields nothing for a
+// single target and the index of the target that died for several. Targets that are already gone do not suspend.
+// In thread-safe mode a suspended coroutine must not be destroyed while its targets may die on other threads.
+template <class Executor, std::size_t N>
+class obs_destroyed_awaitable : private obs_detail::await_state
+{
+public:
+    obs_destroyed_awaitable(Executor executor, std::array<const IObserver *, N> sources)
+        : m_executor(std::move(executor)), m_sources(sources)
+    {
+    }
+
+    obs_destroyed_awaitable(const obs_destroyed_awaitable &) = delete;
+    obs_destroyed_awaitable &operator=(const obs_destroyed_awaitable &) = delete;
+
+    bool await_ready() noexcept
+    {
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            if (!obs_detail::await_node::is_linked(*m_sources[i]))
+            {
+                set_winner(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            if (!m_nodes[i].attach(*m_sources[i], *this, i))
+            {
+                // Died in the meantime
+                fire(i);
+                break;
+            }
+        }
+        return finish_suspend(h);
+    }
+
+    auto await_resume() const noexcept
+    {
+        if constexpr (N > 1)
+        {
+            return winner();
+        }
+    }
+
+private:
+    void schedule(std::coroutine_handle<> h) override
+    {
+        m_executor(h);
+    }
+
+    [[no_unique_address]] Executor m_executor;
+    std::array<const IObserver *, N> m_sources;
+    // Destroyed first, which unregisters them before the state goes away
+    std::array<obs_detail::await_node, N> m_nodes;
+};
+
+// co_await obs_first_destroyed(a, b, c) resumes when any of the observed targets dies and yields its index
+template <class... Observers>
+obs_destroyed_awaitable<obs_inline_executor, sizeof...(Observers)> obs_first_destroyed(const Observers &...observers)
+{
+    return {obs_inline_executor{}, {static_cast<const IObserver *>(&observers)...}};
+}
+
+template <class Executor, class... Observers>
+obs_destroyed_awaitable<Executor, sizeof...(Observers)> obs_first_destroyed_on(Executor executor, const Observers &...observers)
+{
+    return {std::move(executor), {static_cast<const IObserver *>(&observers)...}};
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Inline capacity of the default callback: a lambda capturing four references, or a std::function
+inline constexpr std::size_t obs_callback_default_capacity = 4 * sizeof(void *);
+
+// Move-only void() callable stored inline in Capacity bytes. A callable that fits (see fits_inline) is stored,
+// moved and invoked without allocating. Larger, over-aligned or throwing-move callables are allocated on the
+// heap like std::function does, and the inline storage holds the pointer.
+template <std::size_t Capacity = obs_callback_default_capacity>
+class obs_callback
+{
+    static_assert(Capacity >= sizeof(void *), "obs_callback needs room for at least a pointer");
+
+public:
+    template <class Fn>
+    static constexpr bool fits_inline =
+        sizeof(Fn) <= Capacity && alignof(Fn) <= alignof(void *) && std::is_nothrow_move_constructible_v<Fn>;
+
+    obs_callback() noexcept = default;
+
+    obs_callback(std::nullptr_t) noexcept
+    {
+    }
+
+    template <class F>
+        requires(!std::is_same_v<std::remove_cvref_t<F>, obs_callback> && std::is_invocable_r_v<void, std::decay_t<F> &>)
+    obs_callback(F &&f)
+    {
+        using Fn = std::decay_t<F>;
+        if constexpr (std::is_constructible_v<bool, const Fn &>)
+        {
+            // Null function pointers and empty std::function are stored as an empty callback
+            if (!static_cast<bool>(f))
+            {
+                return;
+            }
+        }
+        if constexpr (fits_inline<Fn>)
+        {
+            ::new (static_cast<void *>(m_storage)) Fn(std::forward<F>(f));
+            m_pOps = &s_ops<Fn>;
+        }
+        else
+        {
+            ::new (static_cast<void *>(m_storage)) Fn *(new Fn(std::forward<F>(f)));
+            m_pOps = &s_heapOps<Fn>;
+        }
+    }
+
+    obs_callback(obs_callback &&other) noexcept
+    {
+        take(other);
+    }
+
+    obs_callback &operator=(obs_callback &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    obs_callback(const obs_callback &) = delete;
+    obs_callback &operator=(const obs_callback &) = delete;
+
+    ~obs_callback()
+    {
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        if (m_pOps != nullptr)
+        {
+            m_pOps->destroy(m_storage);
+            m_pOps = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_pOps != nullptr;
+    }
+
+    void operator()()
+    {
+        m_pOps->invoke(m_storage);
+    }
+
+private:
+    struct ops
+    {
+        void (*invoke)(void *);
+        // Move-constructs into to and destroys from
+        void (*relocate)(void *from, void *to) noexcept;
+        void (*destroy)(void *) noexcept;
+    };
+
+    template <class Fn>
+    static constexpr ops s_ops{
+        [](void *p)
+        { std::invoke(*static_cast<Fn *>(p)); },
+        [](void *from, void *to) noexcept
+        {
+            ::new (to) Fn(std::move(*static_cast<Fn *>(from)));
+            static_cast<Fn *>(from)->~Fn();
+        },
+        [](void *p) noexcept
+        { static_cast<Fn *>(p)->~Fn(); }};
+
+    // The storage holds an Fn *, which relocates by copying the pointer
+    template <class Fn>
+    static constexpr ops s_heapOps{
+        [](void *p)
+        { std::invoke(**static_cast<Fn **>(p)); },
+        [](void *from, void *to) noexcept
+        { ::new (to) Fn *(*static_cast<Fn **>(from)); },
+        [](void *p) noexcept
+        { delete *static_cast<Fn **>(p); }};
+
+    void take(obs_callback &other) noexcept
+    {
+        if (other.m_pOps != nullptr)
+        {
+            other.m_pOps->relocate(other.m_storage, m_storage);
+            m_pOps = std::exchange(other.m_pOps, nullptr);
+        }
+    }
+
+    alignas(void *) unsigned char m_storage[Capacity];
+    const ops *m_pOps = nullptr;
+};
+
+// Callback type for observers that never have a callback. Takes no storage in obs_ptr.
+struct no_callback
+{
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_callback.h"
+#include "obs_metrics.h"
+#include "obs_policy.h"
+#include "obs_sync.h"
+#include "obs_trace.h"
+
+namespace obs_detail
+{
+// Cold half of an obs_compact_ptr: the registration with the target and the callback. Keeps the compact
+// pointer's copy of the link (its mirror) in step with its own, under its hook lock.
+template <class T, class Callback>
+class compact_node : public IObserver
+{
+public:
+    explicit compact_node(link_ptr<T> &mirror) noexcept
+        : m_pMirror(&mirror)
+    {
+    }
+
+    compact_node(const compact_node &) = delete;
+    compact_node &operator=(const compact_node &) = delete;
+
+    ~compact_node()
+    {
+        if (!begin_teardown())
+        {
+            return;
+        }
+        hook_guard guard(*this, true);
+        unlink();
+        notification_batch::cancel(*this);
+    }
+
+    // Observes pObserved instead, keeping a pending notification of the old target
+    void relink(T *pObserved)
+    {
+        hook_guard guard(*this);
+        if (static_cast<IObserved *>(pObserved) == observed_link())
+        {
+            return;
+        }
+        unlink();
+        if (pObserved != nullptr && static_cast<IObserved &>(*pObserved).add_observer(*this))
+        {
+            m_pMirror->store(pObserved);
+        }
+    }
+
+    // Observes the target of other, whose lock keeps it alive while we register
+    void copy_from(const compact_node &other)
+    {
+        hook_guard guardOther(other);
+        hook_guard guard(*this);
+        unlink();
+        auto pObserved = other.observed_link();
+        if (pObserved != nullptr && pObserved->add_observer(*this))
+        {
+            m_pMirror->store(static_cast<T *>(pObserved));
+        }
+    }
+
+    // Unlinks, drops a pending notification and the callback
+    void reset()
+    {
+        hook_guard guard(*this);
+        unlink();
+        notification_batch::cancel(*this);
+        m_cb = {};
+        callback_changed();
+    }
+
+    void set_cb(Callback cb)
+    {
+        hook_guard guard(*this);
+        m_cb = std::move(cb);
+        callback_changed();
+    }
+
+    // Moves the mirror to the compact pointer that took this node over
+    void rehome(link_ptr<T> &mirror) noexcept
+    {
+        hook_guard guard(*this);
+        mirror.store(m_pMirror->load());
+        m_pMirror->store(nullptr);
+        m_pMirror = &mirror;
+    }
+
+    friend class IObserver;
+
+protected:
+    // Called with the hook lock held by the notifying IObserved, which the callback runs without
+    void handle_notification() final
+    {
+        obs_trace::notification(this, has_callback());
+        // A notification deferred by a notification_batch may arrive after we were set to something new
+        if (observed_link() == nullptr)
+        {
+            m_pMirror->store(nullptr);
+        }
+        // The callback may destroy this node along with its compact pointer, so it must be the last thing we do
+        if constexpr (!std::is_same_v<Callback, no_callback>)
+        {
+            if (m_cb)
+            {
+                obs_metrics::count_callback();
+                invoke_callback(m_cb);
+            }
+        }
+    }
+
+    void handle_unlinked() noexcept final
+    {
+        m_pMirror->store(nullptr);
+    }
+
+private:
+    bool has_callback() const noexcept
+    {
+        if constexpr (std::is_same_v<Callback, no_callback>)
+        {
+            return false;
+        }
+        else
+        {
+            return static_cast<bool>(m_cb);
+        }
+    }
+
+    // Requires the hook lock
+    void unlink()
+    {
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        m_pMirror->store(nullptr);
+    }
+
+    link_ptr<T> *m_pMirror;
+    [[no_unique_address]] Callback m_cb;
+};
+} // namespace obs_detail
+
+// Self-nulling pointer with 16 bytes of hot state: the target pointer and a pointer to a cold node holding the
+// registration and the callback. Reading the pointer (get, is_set, comparisons) touches the hot state only, so
+// arrays of compact pointers pack four to a cache line. The cold node is allocated when the pointer is first set
+// or given a callback, and reused until the pointer is destroyed. The target pointer is nulled when the target
+// dies, also when a notification_batch defers the callback.
+//
+// Takes the checking and callback policies of obs_ptr, but no storage or delivery policy: it keeps no weak_ptr,
+// so there is no get_as_weak() and no serialization, and callbacks run inline.
+template <class T, class... Policies>
+class obs_compact_ptr
+{
+    using policies = obs_detail::policy_set<Policies...>;
+    static_assert((!std::is_base_of_v<obs_storage_policy, Policies> && ...), "obs_compact_ptr takes no storage policy");
+    static_assert((!std::is_base_of_v<obs_delivery_policy, Policies> && ...), "obs_compact_ptr takes no delivery policy");
+
+public:
+    using callback_type = typename policies::callback;
+    using check_policy = typename policies::check;
+    using node_type = obs_detail::compact_node<T, callback_type>;
+
+    static constexpr bool has_callback = !std::is_same_v<callback_type, no_callback>;
+
+    obs_compact_ptr() noexcept = default;
+
+    explicit obs_compact_ptr(const std::shared_ptr<T> &spObserved)
+    {
+        set(spObserved);
+    }
+
+    obs_compact_ptr(const std::shared_ptr<T> &spObserved, callback_type cb)
+        requires has_callback
+    {
+        set(spObserved, std::move(cb));
+    }
+
+    ~obs_compact_ptr() = default;
+
+    // Copies observe the same object but do not copy the callback, as with obs_ptr
+    obs_compact_ptr(const obs_compact_ptr &other)
+    {
+        if (other.m_pCold != nullptr && other.is_set())
+        {
+            cold().copy_from(*other.m_pCold);
+        }
+    }
+
+    // Takes over the cold node of other in O(1), other is left unset without one
+    obs_compact_ptr(obs_compact_ptr &&other) noexcept
+        : m_pCold(std::move(other.m_pCold))
+    {
+        if (m_pCold != nullptr)
+        {
+            m_pCold->rehome(m_observed);
+        }
+    }
+
+    obs_compact_ptr &operator=(const obs_compact_ptr &other)
+    {
+        if (this != &other)
+        {
+            if (other.m_pCold != nullptr)
+            {
+                cold().copy_from(*other.m_pCold);
+            }
+            else if (m_pCold != nullptr)
+            {
+                m_pCold->relink(nullptr);
+            }
+        }
+        return *this;
+    }
+
+    obs_compact_ptr &operator=(obs_compact_ptr &&other) noexcept
+    {
+        if (this != &other)
+        {
+            m_pCold = std::move(other.m_pCold);
+            if (m_pCold != nullptr)
+            {
+                m_pCold->rehome(m_observed);
+            }
+        }
+        return *this;
+    }
+
+    bool operator==(std::nullptr_t) const noexcept
+    {
+        return get() == nullptr;
+    }
+
+    bool operator!=(std::nullptr_t) const noexcept
+    {
+        return get() != nullptr;
+    }
+
+    bool operator==(const std::shared_ptr<T> &sp) const noexcept
+    {
+        return get() == sp.get();
+    }
+
+    bool operator!=(const std::shared_ptr<T> &sp) const noexcept
+    {
+        return get() != sp.get();
+    }
+
+    bool operator==(const obs_compact_ptr &other) const noexcept
+    {
+        return get() == other.get();
+    }
+
+    bool operator!=(const obs_compact_ptr &other) const noexcept
+    {
+        return get() != other.get();
+    }
+
+    // Observed object, or nullptr once it is destroyed. Same thread-safety caveats as obs_ptr::get.
+    T *get() const noexcept
+    {
+        return m_observed.load();
+    }
+
+    T *operator->() const noexcept(check_policy::is_nothrow)
+    {
+        T *p = get();
+        check_policy::check(p);
+        return p;
+    }
+
+    T &operator*() const noexcept(check_policy::is_nothrow)
+    {
+        T *p = get();
+        check_policy::check(p);
+        return *p;
+    }
+
+    bool is_set() const noexcept
+    {
+        return get() != nullptr;
+    }
+
+    void set(const std::shared_ptr<T> &spObserved)
+    {
+        if (spObserved != nullptr || m_pCold != nullptr)
+        {
+            cold().relink(spObserved.get());
+        }
+    }
+
+    void set(const std::shared_ptr<T> &spObserved, callback_type cb)
+        requires has_callback
+    {
+        set(spObserved);
+        set_cb(std::move(cb));
+    }
+
+    void unset()
+    {
+        if (m_pCold != nullptr)
+        {
+            m_pCold->reset();
+        }
+    }
+
+    void set_cb(callback_type cb)
+        requires has_callback
+    {
+        cold().set_cb(std::move(cb));
+    }
+
+    void unset_cb()
+    {
+        if constexpr (has_callback)
+        {
+            if (m_pCold != nullptr)
+            {
+                m_pCold->set_cb({});
+            }
+        }
+    }
+
+private:
+    node_type &cold()
+    {
+        if (m_pCold == nullptr)
+        {
+            m_pCold = std::make_unique<node_type>(m_observed);
+        }
+        return *m_pCold;
+    }
+
+    // Copy of the cold node's link, written under its hook lock
+    obs_detail::link_ptr<T> m_observed;
+    std::unique_ptr<node_type> m_pCold;
+};
+
+// nullptr on lhs
+template <class T, class... Policies>
+inline bool operator==(std::nullptr_t, const obs_compact_ptr<T, Policies...> &rhs) noexcept
+{
+    return rhs == nullptr;
+}
+
+template <class T, class... Policies>
+inline bool operator!=(std::nullptr_t, const obs_compact_ptr<T, Policies...> &rhs) noexcept
+{
+    return rhs != nullptr;
+}
+
+// shared_ptr<T> on lhs
+template <class T, class... Policies>
+inline bool operator==(const std::shared_ptr<T> &lhs, const obs_compact_ptr<T, Policies...> &rhs) noexcept
+{
+    return rhs == lhs;
+}
+
+template <class T, class... Policies>
+inline bool operator!=(const std::shared_ptr<T> &lhs, const obs_compact_ptr<T, Policies...> &rhs) noexcept
+{
+    return rhs != lhs;
+}
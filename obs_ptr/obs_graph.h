@@ -0,0 +1,454 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "obs_ptr.h"
+
+// Compact binary format for an observation graph, written to and read from a file descriptor in one pass.
+// The targets' own state is not part of it, only who observes whom:
+//
+//     "OBSG" u32 version
+//     target blocks:  u32 n, n x u64 object id      (n == 0 ends the table)
+//     edge blocks:    u32 n, n x u32 target index   (0xFFFFFFFF is an unset observer, n == 0 ends the graph)
+//
+// All integers are little-endian. Target indices refer to the order targets were added, edges are in the order
+// observers were added. Loading reads the id table, lets the caller recreate the targets, then relinks the
+// observers, visited in the order they were saved, in one linear pass.
+
+namespace obs_detail
+{
+inline constexpr char graph_magic[4] = {'O', 'B', 'S', 'G'};
+inline constexpr std::uint32_t graph_version = 1;
+inline constexpr std::uint32_t graph_unset = 0xFFFFFFFF;
+
+template <class U>
+U to_little_endian(U value) noexcept
+{
+    if constexpr (std::endian::native == std::endian::big)
+    {
+        return std::byteswap(value);
+    }
+    return value;
+}
+
+// Buffered writes to a file descriptor, flushed in large blocks
+class fd_writer
+{
+public:
+    explicit fd_writer(int fd)
+        : m_fd(fd)
+    {
+        m_buffer.reserve(buffer_size);
+    }
+
+    // Writes out whatever is still buffered. Errors cannot be reported from here, call flush() to see them.
+    ~fd_writer()
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    fd_writer(const fd_writer &) = delete;
+    fd_writer &operator=(const fd_writer &) = delete;
+
+    template <class U>
+    void put(U value)
+    {
+        value = to_little_endian(value);
+        put_bytes(&value, sizeof(U));
+    }
+
+    void put_bytes(const void *p, std::size_t size)
+    {
+        auto pBytes = static_cast<const unsigned char *>(p);
+        while (size > 0)
+        {
+            if (m_buffer.size() == buffer_size)
+            {
+                flush();
+            }
+            std::size_t n = std::min(size, buffer_size - m_buffer.size());
+            m_buffer.insert(m_buffer.end(), pBytes, pBytes + n);
+            pBytes += n;
+            size -= n;
+        }
+    }
+
+    void flush()
+    {
+        std::size_t written = 0;
+        while (written < m_buffer.size())
+        {
+#ifdef _WIN32
+            auto result = ::_write(m_fd, m_buffer.data() + written, static_cast<unsigned>(m_buffer.size() - written));
+#else
+            auto result = ::write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+#endif
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "obs_graph write");
+            }
+            written += static_cast<std::size_t>(result);
+        }
+        m_buffer.clear();
+    }
+
+    static constexpr std::size_t buffer_size = 1 << 16;
+
+private:
+    int m_fd;
+    std::vector<unsigned char> m_buffer;
+};
+
+// Buffered reads from a file descriptor. The descriptor may hold other data after the graph, so a read never
+// asks for more than the bytes announced through expect().
+class fd_reader
+{
+public:
+    explicit fd_reader(int fd)
+        : m_fd(fd), m_buffer(1 << 16)
+    {
+    }
+
+    // Announces that size more bytes of the graph follow those announced so far
+    void expect(std::size_t size) noexcept
+    {
+        m_ahead += size;
+    }
+
+    template <class U>
+    U get()
+    {
+        U value;
+        get_bytes(&value, sizeof(U));
+        return to_little_endian(value);
+    }
+
+    // Reads size bytes, which must have been announced
+    void get_bytes(void *p, std::size_t size)
+    {
+        if (size > m_ahead)
+        {
+            throw std::logic_error("obs_graph: read past the announced input");
+        }
+        m_ahead -= size;
+        auto pOut = static_cast<unsigned char *>(p);
+        while (size > 0)
+        {
+            if (m_pos == m_end)
+            {
+                fill(size + m_ahead);
+            }
+            std::size_t n = std::min(size, m_end - m_pos);
+            std::memcpy(pOut, m_buffer.data() + m_pos, n);
+            m_pos += n;
+            pOut += n;
+            size -= n;
+        }
+    }
+
+private:
+    // Reads at most limit bytes, the announced bytes not yet buffered
+    void fill(std::size_t limit)
+    {
+        const std::size_t size = std::min(limit, m_buffer.size());
+        for (;;)
+        {
+#ifdef _WIN32
+            auto result = ::_read(m_fd, m_buffer.data(), static_cast<unsigned>(size));
+#else
+            auto result = ::read(m_fd, m_buffer.data(), size);
+#endif
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "obs_graph read");
+            }
+            if (result == 0)
+            {
+                throw std::runtime_error("obs_graph: unexpected end of input");
+            }
+            m_pos = 0;
+            m_end = static_cast<std::size_t>(result);
+            return;
+        }
+    }
+
+    int m_fd;
+    std::vector<unsigned char> m_buffer;
+    std::size_t m_pos = 0;
+    std::size_t m_end = 0;
+    // Announced bytes not yet returned by get_bytes, whether buffered or not
+    std::size_t m_ahead = 0;
+};
+} // namespace obs_detail
+
+// Streams an observation graph to a file descriptor. Add every target first, then every observer, then call
+// finish(). A writer destroyed without finish() still writes out what it buffered, which a reader rejects as
+// truncated. The descriptor is not closed.
+class obs_graph_writer
+{
+public:
+    explicit obs_graph_writer(int fd)
+        : m_out(fd)
+    {
+        m_out.put_bytes(obs_detail::graph_magic, sizeof(obs_detail::graph_magic));
+        m_out.put(obs_detail::graph_version);
+    }
+
+    obs_graph_writer(const obs_graph_writer &) = delete;
+    obs_graph_writer &operator=(const obs_graph_writer &) = delete;
+
+    // Returns the index the target is saved under. objectId is whatever the caller needs to recreate it.
+    std::uint32_t add_target(const IObserved &target, std::uint64_t objectId)
+    {
+        if (m_inEdges)
+        {
+            throw std::logic_error("obs_graph_writer: targets must be added before observers");
+        }
+        auto index = static_cast<std::uint32_t>(m_indices.size());
+        if (!m_indices.emplace(&target, index).second)
+        {
+            throw std::logic_error("obs_graph_writer: target added twice");
+        }
+        m_block.push_back(objectId);
+        if (m_block.size() == block_size)
+        {
+            write_ids();
+        }
+        return index;
+    }
+
+    // Observers of targets that were not added are saved as unset
+    template <class T, class... Policies>
+    void add_observer(const obs_ptr<T, Policies...> &observer)
+    {
+        if (!m_inEdges)
+        {
+            end_targets();
+        }
+        std::uint32_t index = obs_detail::graph_unset;
+        if (auto pTarget = observer.get())
+        {
+            auto it = m_indices.find(static_cast<const IObserved *>(pTarget));
+            if (it != m_indices.end())
+            {
+                index = it->second;
+            }
+        }
+        m_edges.push_back(index);
+        if (m_edges.size() == block_size)
+        {
+            write_edges();
+        }
+    }
+
+    // Terminates the graph and flushes it. Nothing can be added afterwards.
+    void finish()
+    {
+        if (!m_inEdges)
+        {
+            end_targets();
+        }
+        write_edges();
+        m_out.put(std::uint32_t{0});
+        m_out.flush();
+    }
+
+private:
+    static constexpr std::size_t block_size = 4096;
+
+    void end_targets()
+    {
+        write_ids();
+        m_out.put(std::uint32_t{0});
+        m_inEdges = true;
+    }
+
+    void write_ids()
+    {
+        if (m_block.empty())
+        {
+            return;
+        }
+        m_out.put(static_cast<std::uint32_t>(m_block.size()));
+        for (auto id : m_block)
+        {
+            m_out.put(id);
+        }
+        m_block.clear();
+    }
+
+    void write_edges()
+    {
+        if (m_edges.empty())
+        {
+            return;
+        }
+        m_out.put(static_cast<std::uint32_t>(m_edges.size()));
+        for (auto index : m_edges)
+        {
+            m_out.put(index);
+        }
+        m_edges.clear();
+    }
+
+    obs_detail::fd_writer m_out;
+    std::unordered_map<const IObserved *, std::uint32_t> m_indices;
+    std::vector<std::uint64_t> m_block;
+    std::vector<std::uint32_t> m_edges;
+    bool m_inEdges = false;
+};
+
+// Reads a graph written by obs_graph_writer. Call target_ids() first, recreate the targets in that order,
+// then relink the observers in the order they were saved.
+class obs_graph_reader
+{
+public:
+    explicit obs_graph_reader(int fd)
+        : m_in(fd)
+    {
+        // The header and the first target block count
+        m_in.expect(sizeof(obs_detail::graph_magic) + 2 * sizeof(std::uint32_t));
+        char magic[sizeof(obs_detail::graph_magic)];
+        m_in.get_bytes(magic, sizeof(magic));
+        if (std::memcmp(magic, obs_detail::graph_magic, sizeof(magic)) != 0)
+        {
+            throw std::runtime_error("obs_graph: not an observation graph");
+        }
+        if (m_in.get<std::uint32_t>() != obs_detail::graph_version)
+        {
+            throw std::runtime_error("obs_graph: unsupported version");
+        }
+    }
+
+    obs_graph_reader(const obs_graph_reader &) = delete;
+    obs_graph_reader &operator=(const obs_graph_reader &) = delete;
+
+    // Object ids of the saved targets, indexed like the targets passed to relink
+    const std::vector<std::uint64_t> &target_ids()
+    {
+        if (!m_idsRead)
+        {
+            while (auto n = m_in.get<std::uint32_t>())
+            {
+                // The block and the next block count
+                m_in.expect(n * sizeof(std::uint64_t) + sizeof(std::uint32_t));
+                for (std::uint32_t i = 0; i < n; ++i)
+                {
+                    m_ids.push_back(m_in.get<std::uint64_t>());
+                }
+            }
+            // The first edge block count
+            m_in.expect(sizeof(std::uint32_t));
+            m_idsRead = true;
+        }
+        return m_ids;
+    }
+
+    // Relinks the next saved observer. resolve(index) returns the shared_ptr<T> recreated for that target.
+    template <class T, class... Policies, class Resolve>
+    void relink(obs_ptr<T, Policies...> &observer, Resolve &&resolve)
+    {
+        auto index = next_edge();
+        if (index == obs_detail::graph_unset)
+        {
+            observer.set(nullptr);
+            return;
+        }
+        if (index >= m_ids.size())
+        {
+            throw std::runtime_error("obs_graph: target index out of range");
+        }
+        observer.set(resolve(index));
+    }
+
+    // Relinks every observer in observers, in order. targets[i] is the shared_ptr recreated for target i.
+    template <class Observers, class Targets>
+    void relink_all(Observers &&observers, const Targets &targets)
+    {
+        if (std::size(targets) < target_ids().size())
+        {
+            throw std::runtime_error("obs_graph: fewer targets than saved");
+        }
+        for (auto &observer : observers)
+        {
+            relink(observer, [&targets](std::uint32_t index) -> const auto &
+                   { return targets[index]; });
+        }
+    }
+
+    // True once every saved observer was relinked
+    bool at_end()
+    {
+        return peek_edges() == 0;
+    }
+
+private:
+    std::uint32_t peek_edges()
+    {
+        target_ids();
+        if (m_edgesLeft == 0 && !m_done)
+        {
+            m_edgesLeft = m_in.get<std::uint32_t>();
+            m_done = m_edgesLeft == 0;
+            if (!m_done)
+            {
+                // The block and the next block count
+                m_in.expect(m_edgesLeft * sizeof(std::uint32_t) + sizeof(std::uint32_t));
+            }
+        }
+        return m_edgesLeft;
+    }
+
+    std::uint32_t next_edge()
+    {
+        if (peek_edges() == 0)
+        {
+            throw std::runtime_error("obs_graph: more observers than saved");
+        }
+        m_edgesLeft--;
+        return m_in.get<std::uint32_t>();
+    }
+
+    obs_detail::fd_reader m_in;
+    std::vector<std::uint64_t> m_ids;
+    std::uint32_t m_edgesLeft = 0;
+    bool m_idsRead = false;
+    bool m_done = false;
+};
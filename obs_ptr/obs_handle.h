@@ -0,0 +1,406 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_callback.h"
+#include "obs_sync.h"
+#include "obs_trace.h"
+
+// ========================
+// Forward Declarations
+// ========================
+template <class T>
+class IHandleObserved;
+
+template <class T>
+class obs_handle;
+
+namespace obs_detail
+{
+// Slots for every live object of one type, addressed by index. Each slot carries a generation that is bumped when
+// its object is destroyed, which invalidates every handle to it at once. Slots live in fixed pages that are never
+// moved or freed, so a lookup never races with growth and any handle, however stale, can still be checked.
+template <class Object>
+class slot_map
+{
+public:
+    static constexpr std::uint32_t page_bits = 12;
+    static constexpr std::uint32_t page_size = 1u << page_bits;
+    static constexpr std::uint32_t max_pages = 1u << 14;
+
+    // Object in the slot if generation is still current, nullptr otherwise. Generation 0 is the null handle, and
+    // an index that was never handed out (say, from a corrupt archive) finds nothing.
+    Object *find(std::uint32_t index, std::uint32_t generation) const noexcept
+    {
+        if (generation == 0 || index >= m_size.load())
+        {
+            return nullptr;
+        }
+        const slot &s = at(index);
+        if (s.generation.load() != generation)
+        {
+            return nullptr;
+        }
+        // The slot may have been released and reused since. A reused slot publishes its new object after bumping
+        // the generation, so reading the generation again after the object tells whether the object is ours.
+        Object *pObject = s.pObject.load();
+        return s.generation.load() == generation ? pObject : nullptr;
+    }
+
+    // 0 (the null handle's generation) for an index that was never handed out
+    std::uint32_t generation(std::uint32_t index) const noexcept
+    {
+        return index < m_size.load() ? at(index).generation.load() : 0;
+    }
+
+    // Throws std::length_error when all max_pages * page_size slots are taken
+    std::uint32_t acquire(Object &object)
+    {
+        std::lock_guard lock(m_lock);
+        std::uint32_t index;
+        if (m_freeCount > 0)
+        {
+            index = m_freeHead;
+            m_freeHead = at(index).nextFree;
+            m_freeCount--;
+        }
+        else
+        {
+            index = m_size.load();
+            if ((index & (page_size - 1)) == 0)
+            {
+                if ((index >> page_bits) >= max_pages)
+                {
+                    throw std::length_error("obs_handle: too many live objects of one type");
+                }
+                m_pages[index >> page_bits].store(new slot[page_size]);
+            }
+        }
+        at(index).pObject.store(&object);
+        if (index == m_size.load())
+        {
+            // Published after its page and object
+            m_size.store(index + 1);
+        }
+        return index;
+    }
+
+    void release(std::uint32_t index) noexcept
+    {
+        std::lock_guard lock(m_lock);
+        slot &s = at(index);
+        // Generation 0 is reserved for the null handle
+        std::uint32_t next = s.generation.load() + 1;
+        s.generation.store(next != 0 ? next : 1);
+        s.nextFree = m_freeHead;
+        m_freeHead = index;
+        m_freeCount++;
+    }
+
+private:
+    // Read without the lock by find, so in thread-safe mode both are atomic with release/acquire ordering
+    template <class V>
+    class published
+    {
+    public:
+        explicit published(V value = {}) noexcept
+            : m_value(value)
+        {
+        }
+
+        V load() const noexcept
+        {
+            if constexpr (thread_safe)
+            {
+                return m_value.load(std::memory_order_acquire);
+            }
+            else
+            {
+                return m_value;
+            }
+        }
+
+        void store(V value) noexcept
+        {
+            if constexpr (thread_safe)
+            {
+                m_value.store(value, std::memory_order_release);
+            }
+            else
+            {
+                m_value = value;
+            }
+        }
+
+    private:
+        std::conditional_t<thread_safe, std::atomic<V>, V> m_value;
+    };
+
+    struct slot
+    {
+        published<std::uint32_t> generation{1};
+        published<Object *> pObject;
+        std::uint32_t nextFree = 0;
+    };
+
+    slot &at(std::uint32_t index) const noexcept
+    {
+        return m_pages[index >> page_bits].load()[index & (page_size - 1)];
+    }
+
+    link_ptr<slot> m_pages[max_pages];
+    // Slots handed out so far
+    published<std::uint32_t> m_size;
+    std::uint32_t m_freeHead = 0;
+    std::uint32_t m_freeCount = 0;
+    mutable lock_type m_lock;
+};
+} // namespace obs_detail
+
+// Observed object addressed through handles instead of registered pointers. T must derive from IHandleObserved<T>.
+// Destroying the object invalidates all of its handles in O(1) without visiting them. Being an IObserved as well,
+// it still notifies the obs_ptr and obs_handle_watch observers registered with it.
+template <class T>
+class IHandleObserved : public IObserved
+{
+public:
+    obs_handle<T> handle() const noexcept
+    {
+        return obs_handle<T>(m_slotIndex, s_slots.generation(m_slotIndex));
+    }
+
+    friend class obs_handle<T>;
+
+protected:
+    IHandleObserved()
+        : m_slotIndex(s_slots.acquire(*this))
+    {
+    }
+
+    // A copy is a different object with its own slot
+    IHandleObserved(const IHandleObserved &other)
+        : IObserved(other), m_slotIndex(s_slots.acquire(*this))
+    {
+    }
+
+    IHandleObserved &operator=(const IHandleObserved &) noexcept
+    {
+        return *this;
+    }
+
+    ~IHandleObserved() override
+    {
+        s_slots.release(m_slotIndex);
+    }
+
+private:
+    std::uint32_t m_slotIndex;
+
+    static inline obs_detail::slot_map<IHandleObserved> s_slots;
+};
+
+// (index, generation) reference to an IHandleObserved<T>. Trivially copyable, 8 bytes, nothing to register or
+// unregister. Checking it is one lookup and one generation compare.
+// Handles are only meaningful within the process that created them; serializing one stores the pair as is.
+template <class T>
+class obs_handle
+{
+public:
+    obs_handle() noexcept = default;
+
+    obs_handle(std::nullptr_t) noexcept
+    {
+    }
+
+    // Target, or nullptr once it is destroyed. In thread-safe mode only safe to dereference while the caller
+    // otherwise knows the target is alive.
+    T *get() const noexcept
+    {
+        return static_cast<T *>(IHandleObserved<T>::s_slots.find(m_index, m_generation));
+    }
+
+    T *operator->() const noexcept
+    {
+        return get();
+    }
+
+    T &operator*() const noexcept
+    {
+        return *get();
+    }
+
+    bool is_set() const noexcept
+    {
+        return get() != nullptr;
+    }
+
+    void reset() noexcept
+    {
+        *this = {};
+    }
+
+    bool operator==(std::nullptr_t) const noexcept
+    {
+        return get() == nullptr;
+    }
+
+    bool operator==(const obs_handle &other) const noexcept
+    {
+        return get() == other.get();
+    }
+
+    std::uint32_t index() const noexcept
+    {
+        return m_index;
+    }
+
+    std::uint32_t generation() const noexcept
+    {
+        return m_generation;
+    }
+
+    template <class Archive>
+    void serialize(Archive &ar)
+    {
+        ar(m_index, m_generation);
+    }
+
+    friend class IHandleObserved<T>;
+
+private:
+    obs_handle(std::uint32_t index, std::uint32_t generation) noexcept
+        : m_index(index), m_generation(generation)
+    {
+    }
+
+    std::uint32_t m_index = 0;
+    std::uint32_t m_generation = 0;
+};
+
+// Observer that runs a callback when the target of a handle is destroyed. Only needed for handles that want the
+// callback; plain handles register nothing. Registers with the target like obs_ptr, so it works with
+// notification_batch and the thread-safe mode. Movable, not copyable.
+template <class T, class Callback = obs_callback<>>
+class obs_handle_watch : public IObserver
+{
+public:
+    obs_handle_watch() = default;
+
+    obs_handle_watch(obs_handle<T> handle, Callback cb)
+        : m_cb(std::move(cb))
+    {
+        set(handle);
+    }
+
+    ~obs_handle_watch()
+    {
+        if (!begin_teardown())
+        {
+            return;
+        }
+        hook_guard guard(*this, true);
+        unlink();
+    }
+
+    obs_handle_watch(obs_handle_watch &&other) noexcept
+        : IObserver(other)
+    {
+        hook_guard guardOther(other, true);
+        hook_guard guard(*this);
+        move_from(other);
+    }
+
+    obs_handle_watch &operator=(obs_handle_watch &&other) noexcept
+    {
+        if (this != &other)
+        {
+            hook_guard guard(*this);
+            hook_guard guardOther(other, true);
+            unlink();
+            move_from(other);
+            callback_changed();
+        }
+        return *this;
+    }
+
+    // Registers with the target of handle if it is alive. The target must not be destroyed concurrently.
+    void set(obs_handle<T> handle)
+    {
+        hook_guard guard(*this);
+        unlink();
+        m_handle = handle;
+        if (T *pTarget = handle.get())
+        {
+            static_cast<IObserved &>(*pTarget).add_observer(*this);
+        }
+    }
+
+    void unset()
+    {
+        hook_guard guard(*this);
+        unlink();
+        m_handle.reset();
+    }
+
+    obs_handle<T> handle() const noexcept
+    {
+        return m_handle;
+    }
+
+    bool is_set() const noexcept
+    {
+        return observed_link() != nullptr;
+    }
+
+    friend class IObserver;
+
+protected:
+    void handle_notification() final
+    {
+        obs_trace::notification(this, static_cast<bool>(m_cb));
+        if (m_cb)
+        {
+            obs_metrics::count_callback();
+            invoke_callback(m_cb);
+        }
+    }
+
+private:
+    void unlink()
+    {
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        notification_batch::cancel(*this);
+    }
+
+    void move_from(obs_handle_watch &other) noexcept
+    {
+        if (auto pObserved = other.observed_link())
+        {
+            pObserved->relocate_observer(other, *this);
+        }
+        notification_batch::relocate(other, *this);
+        m_handle = std::exchange(other.m_handle, {});
+        m_cb = std::exchange(other.m_cb, {});
+    }
+
+    obs_handle<T> m_handle;
+    Callback m_cb;
+};
@@ -0,0 +1,330 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "obs_sync.h"
+
+// Hazard pointers let readers reach an observed object without touching its shared reference count.
+// A reader publishes the object it is about to use in a hazard record of its own (one cache line each, so
+// readers never share a line). An object created by make_observed is not deleted while any record holds it;
+// its deletion is retired and carried out by whichever thread releases the last hazard on it. Other releases
+// leave the retired list alone until it grows past a threshold, so unpinning is normally a few atomic operations.
+
+namespace obs_detail
+{
+struct alignas(64) hazard_record
+{
+    std::atomic<const void *> pProtected{nullptr};
+    std::atomic<bool> owned{false};
+    // Set when an object this record protects is retired, so the pin releasing it reclaims it
+    std::atomic<bool> retiredHit{false};
+    hazard_record *pNext = nullptr;
+};
+
+class hazard_domain
+{
+public:
+    static hazard_domain &instance()
+    {
+        static hazard_domain s_domain;
+        return s_domain;
+    }
+
+    // Records are never freed, a released one is reused by the next thread that needs one
+    hazard_record &acquire_record()
+    {
+        for (auto pRecord = m_pHead.load(std::memory_order_acquire); pRecord != nullptr; pRecord = pRecord->pNext)
+        {
+            bool expected = false;
+            if (!pRecord->owned.load(std::memory_order_relaxed) &&
+                pRecord->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return *pRecord;
+            }
+        }
+        auto pRecord = new hazard_record;
+        pRecord->owned.store(true, std::memory_order_relaxed);
+        auto pHead = m_pHead.load(std::memory_order_relaxed);
+        do
+        {
+            pRecord->pNext = pHead;
+        } while (!m_pHead.compare_exchange_weak(pHead, pRecord, std::memory_order_release, std::memory_order_relaxed));
+        return *pRecord;
+    }
+
+    void release_record(hazard_record &record) noexcept
+    {
+        record.pProtected.store(nullptr, std::memory_order_release);
+        record.owned.store(false, std::memory_order_release);
+    }
+
+    // Retired objects that make an unpinning thread scan even if none of them was pinned by it
+    static constexpr std::size_t scan_threshold = 64;
+
+    // Calls reclaim(p) as soon as no hazard record protects p, possibly right away
+    void retire(void *p, void (*reclaim)(void *))
+    {
+        {
+            std::lock_guard lock(m_lock);
+            m_retired.push_back({p, reclaim});
+            m_retiredCount.store(m_retired.size(), std::memory_order_relaxed);
+        }
+        scan();
+    }
+
+    std::size_t retired_count() const noexcept
+    {
+        return m_retiredCount.load(std::memory_order_relaxed);
+    }
+
+    // Reclaims every retired object no longer protected. Reuses per-thread scratch storage, so it only allocates
+    // while the retired list grows.
+    void scan()
+    {
+        scan_scratch &scratch = local_scratch();
+        if (scratch.active)
+        {
+            // Retired by a destructor run from our own scan, which goes round again
+            scratch.rescan = true;
+            return;
+        }
+        scratch.active = true;
+        do
+        {
+            scratch.rescan = false;
+            // Pairs with the fence in pin: either the reader sees the nulled link, or we see its hazard
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::lock_guard lock(m_lock);
+                scratch.candidates.swap(m_retired);
+            }
+            for (auto &r : scratch.candidates)
+            {
+                if (flag_protector(r.p))
+                {
+                    scratch.kept.push_back(r);
+                }
+                else
+                {
+                    // May run destructors that retire more objects, so no lock is held
+                    r.reclaim(r.p);
+                }
+            }
+            {
+                std::lock_guard lock(m_lock);
+                m_retired.insert(m_retired.end(), scratch.kept.begin(), scratch.kept.end());
+                m_retiredCount.store(m_retired.size(), std::memory_order_relaxed);
+            }
+            scratch.candidates.clear();
+            scratch.kept.clear();
+        } while (scratch.rescan);
+        scratch.active = false;
+    }
+
+private:
+    struct retired
+    {
+        void *p;
+        void (*reclaim)(void *);
+    };
+
+    struct scan_scratch
+    {
+        std::vector<retired> candidates;
+        std::vector<retired> kept;
+        bool active = false;
+        bool rescan = false;
+    };
+
+    static scan_scratch &local_scratch()
+    {
+        static thread_local scan_scratch s_scratch;
+        return s_scratch;
+    }
+
+    // Whether a record protects p, flagging the record so that releasing it scans. A record released before it
+    // sees the flag no longer protects p when we look again, see obs_pin::reset.
+    bool flag_protector(const void *p) const noexcept
+    {
+        for (auto pRecord = m_pHead.load(std::memory_order_acquire); pRecord != nullptr; pRecord = pRecord->pNext)
+        {
+            if (pRecord->pProtected.load(std::memory_order_seq_cst) == p)
+            {
+                pRecord->retiredHit.store(true, std::memory_order_seq_cst);
+                if (pRecord->pProtected.load(std::memory_order_seq_cst) == p)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::atomic<hazard_record *> m_pHead{nullptr};
+    std::vector<retired> m_retired;
+    std::atomic<std::size_t> m_retiredCount{0};
+    spin_lock m_lock;
+};
+
+// Records owned by this thread and currently unused, returned to the domain when the thread exits
+class hazard_record_cache
+{
+public:
+    ~hazard_record_cache()
+    {
+        for (auto pRecord : m_records)
+        {
+            hazard_domain::instance().release_record(*pRecord);
+        }
+    }
+
+    static hazard_record &acquire()
+    {
+        auto &records = local().m_records;
+        if (records.empty())
+        {
+            return hazard_domain::instance().acquire_record();
+        }
+        auto pRecord = records.back();
+        records.pop_back();
+        return *pRecord;
+    }
+
+    static void release(hazard_record &record) noexcept
+    {
+        record.pProtected.store(nullptr, std::memory_order_release);
+        try
+        {
+            local().m_records.push_back(&record);
+        }
+        catch (...)
+        {
+            hazard_domain::instance().release_record(record);
+        }
+    }
+
+private:
+    static hazard_record_cache &local()
+    {
+        static thread_local hazard_record_cache s_cache;
+        return s_cache;
+    }
+
+    std::vector<hazard_record *> m_records;
+};
+
+// Deleter installed by make_observed. Nulls the observers first, so no new pin can reach the object,
+// then defers the actual delete until the object is no longer pinned.
+template <class T>
+struct hazard_deleter
+{
+    void operator()(T *p) const
+    {
+        auto pObserved = static_cast<IObserved *>(p);
+        pObserved->notify_all();
+        hazard_domain::instance().retire(pObserved, [](void *q)
+                                         { delete static_cast<T *>(static_cast<IObserved *>(q)); });
+    }
+};
+} // namespace obs_detail
+
+// Creates a target whose deletion waits for outstanding obs_ptr::pin() guards. Observers are still nulled
+// (and their callbacks run) as soon as the last shared_ptr goes away; only ~T and the free are deferred.
+template <class T, class... Args>
+std::shared_ptr<T> make_observed(Args &&...args)
+{
+    return std::shared_ptr<T>(new T(std::forward<Args>(args)...), obs_detail::hazard_deleter<T>{});
+}
+
+// Keeps a target created by make_observed from being deleted while it exists. Move-only, holds no reference count.
+template <class T>
+class obs_pin
+{
+public:
+    obs_pin() noexcept = default;
+
+    obs_pin(obs_pin &&other) noexcept
+        : m_p(std::exchange(other.m_p, nullptr)), m_pRecord(std::exchange(other.m_pRecord, nullptr))
+    {
+    }
+
+    obs_pin &operator=(obs_pin &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_p = std::exchange(other.m_p, nullptr);
+            m_pRecord = std::exchange(other.m_pRecord, nullptr);
+        }
+        return *this;
+    }
+
+    obs_pin(const obs_pin &) = delete;
+    obs_pin &operator=(const obs_pin &) = delete;
+
+    ~obs_pin()
+    {
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        m_p = nullptr;
+        if (auto pRecord = std::exchange(m_pRecord, nullptr))
+        {
+            // Pairs with flag_protector: either it sees the hazard cleared, or we see its flag
+            pRecord->pProtected.store(nullptr, std::memory_order_seq_cst);
+            const bool retiredHit = pRecord->retiredHit.exchange(false, std::memory_order_seq_cst);
+            obs_detail::hazard_record_cache::release(*pRecord);
+            // Our target was retired while we held it, or the retired list is long enough to be worth a scan
+            auto &domain = obs_detail::hazard_domain::instance();
+            if (retiredHit || domain.retired_count() >= obs_detail::hazard_domain::scan_threshold)
+            {
+                domain.scan();
+            }
+        }
+    }
+
+    T *get() const noexcept
+    {
+        return m_p;
+    }
+
+    T *operator->() const noexcept
+    {
+        return m_p;
+    }
+
+    T &operator*() const noexcept
+    {
+        return *m_p;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_p != nullptr;
+    }
+
+    template <class U, class... Policies>
+    friend class obs_ptr;
+
+private:
+    obs_pin(T *p, obs_detail::hazard_record &record) noexcept
+        : m_p(p), m_pRecord(&record)
+    {
+    }
+
+    T *m_p = nullptr;
+    obs_detail::hazard_record *m_pRecord = nullptr;
+};
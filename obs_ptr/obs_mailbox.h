@@ -0,0 +1,74 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cstddef>
+#include <thread>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserver.h"
+#include "notification_batch.h"
+
+// Home for the callbacks of observers declared with obs_deliver_home. A target destroyed on another thread still
+// nulls such an observer immediately, but posts its notification here instead of running the callback. The
+// thread that created the mailbox runs the callbacks when it drains it, e.g. once per frame of its event loop:
+//
+//     obs_mailbox mailbox; // on the UI thread
+//     obs_ptr<Entity, obs_deliver_home> ptr(spEntity, [this]() { refresh(); });
+//     ptr.set_home(&mailbox);
+//     ...
+//     mailbox.drain(); // callbacks of entities destroyed by workers run here
+//
+// Posting is a lock-free push onto an intrusive stack. The stack entry is part of the observer, so posting
+// neither allocates nor waits for the owning thread. Draining, and
+// destroying or moving an observer whose notification is posted, take the mailbox's lock. Notifications are
+// delivered in the order they were posted, once per observer, and dropped if the observer is destroyed or unset
+// first, as in a notification_batch. Cross-thread delivery needs OBS_PTR_THREAD_SAFE.
+//
+// The mailbox must outlive the observers homed to it. Destroying it drains it one last time.
+class obs_mailbox
+{
+public:
+    obs_mailbox() noexcept
+        : m_batch(notification_batch::mailbox_tag{}), m_owner(std::this_thread::get_id())
+    {
+    }
+
+    ~obs_mailbox()
+    {
+        drain();
+    }
+
+    obs_mailbox(const obs_mailbox &) = delete;
+    obs_mailbox &operator=(const obs_mailbox &) = delete;
+
+    // Runs the callbacks posted so far. Must be called on the owning thread. Returns the number of observers
+    // notified.
+    std::size_t drain()
+    {
+        return m_batch.dispatch_mail();
+    }
+
+    // Whether the calling thread owns this mailbox
+    bool is_home_thread() const noexcept
+    {
+        return std::this_thread::get_id() == m_owner;
+    }
+
+    template <class T, class... Policies>
+    friend class obs_ptr;
+
+private:
+    // Called from the observer's handle_notification, with its hook lock held
+    template <class Observer>
+    void post(Observer &observer, obs_detail::mail_node &mail) noexcept
+    {
+        m_batch.post(observer, mail);
+    }
+
+    notification_batch m_batch;
+    std::thread::id m_owner;
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_sync.h"
+
+namespace obs_detail
+{
+// Entry of an obs_map or obs_cache: the value stored for one target, registered with that target. Never moves,
+// both containers keep it in a node-based container. Owner::erase_dead removes it when the target dies.
+template <class Owner, class T, class V>
+class keyed_node : public IObserver
+{
+public:
+    template <class... Args>
+    keyed_node(Owner &owner, const T *pKey, Args &&...args)
+        : m_value(std::forward<Args>(args)...), m_pOwner(&owner), m_pKey(pKey)
+    {
+    }
+
+    keyed_node(const keyed_node &) = delete;
+    keyed_node &operator=(const keyed_node &) = delete;
+
+    ~keyed_node()
+    {
+        if (!begin_teardown())
+        {
+            return;
+        }
+        hook_guard guard(*this, true);
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        notification_batch::cancel(*this);
+    }
+
+    // False once the target is destroyed, while a notification_batch still defers the erasure
+    bool is_live() const noexcept
+    {
+        return observed_link() != nullptr;
+    }
+
+    const T *key() const noexcept
+    {
+        return m_pKey;
+    }
+
+    V &value() noexcept
+    {
+        return m_value;
+    }
+
+    friend class IObserver;
+    friend Owner;
+
+protected:
+    void handle_notification() final
+    {
+        m_pOwner->erase_dead(*this);
+    }
+
+private:
+    bool link(T &observed)
+    {
+        hook_guard guard(*this);
+        return static_cast<IObserved &>(observed).add_observer(*this);
+    }
+
+    V m_value;
+    Owner *m_pOwner;
+    const T *m_pKey;
+};
+} // namespace obs_detail
+
+// Map from targets to values that erases an entry when its target is destroyed. Replaces pairing each entry with
+// a make_observer callback: an entry is a single node holding the value and its registration, with no separate
+// observer or callback allocation. Keys are the targets' addresses, so lookups hash a pointer and never lock a
+// weak_ptr. An entry whose target died inside a notification_batch is not found again, even if a new target
+// reuses the address, and is erased when the batch dispatches.
+//
+// Not synchronized: an entry is erased on the thread destroying its target, so in thread-safe mode targets must
+// not be destroyed concurrently with any other use of the map. Not copyable or movable, its entries point back
+// at it.
+template <class T, class V>
+class obs_map
+{
+public:
+    using node_type = obs_detail::keyed_node<obs_map, T, V>;
+
+    obs_map() = default;
+
+    ~obs_map()
+    {
+        clear();
+    }
+
+    obs_map(const obs_map &) = delete;
+    obs_map &operator=(const obs_map &) = delete;
+
+    // Value of spKey, constructed from args if it has none. Returns nullptr if spKey is null or being destroyed.
+    template <class... Args>
+    V *try_emplace(const std::shared_ptr<T> &spKey, Args &&...args)
+    {
+        if (spKey == nullptr)
+        {
+            return nullptr;
+        }
+        const T *pKey = spKey.get();
+        auto it = m_entries.find(pKey);
+        if (it != m_entries.end())
+        {
+            if (it->second.is_live())
+            {
+                return &it->second.value();
+            }
+            // Left behind by a dead target at the same address
+            m_entries.extract(it);
+        }
+        it = m_entries.try_emplace(pKey, *this, pKey, std::forward<Args>(args)...).first;
+        if (!it->second.link(*spKey))
+        {
+            m_entries.extract(it);
+            return nullptr;
+        }
+        return &it->second.value();
+    }
+
+    // Value of the target at pKey, or nullptr
+    V *find(const T *pKey) noexcept
+    {
+        auto it = m_entries.find(pKey);
+        return it != m_entries.end() && it->second.is_live() ? &it->second.value() : nullptr;
+    }
+
+    bool contains(const T *pKey) const noexcept
+    {
+        auto it = m_entries.find(pKey);
+        return it != m_entries.end() && it->second.is_live();
+    }
+
+    // Erases the entry of the target at pKey and detaches from it. Returns whether there was one.
+    bool erase(const T *pKey)
+    {
+        auto entry = m_entries.extract(pKey);
+        return !entry.empty() && entry.mapped().is_live();
+    }
+
+    // Erases every entry
+    void clear()
+    {
+        while (!m_entries.empty())
+        {
+            m_entries.extract(m_entries.begin());
+        }
+    }
+
+    // Number of entries, counting those a notification_batch has yet to erase
+    std::size_t size() const noexcept
+    {
+        return m_entries.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return m_entries.empty();
+    }
+
+    friend node_type;
+
+private:
+    void erase_dead(node_type &node)
+    {
+        // The node is destroyed once the map no longer refers to it, so a value whose destruction destroys
+        // other targets may erase their entries too
+        auto entry = m_entries.extract(node.key());
+    }
+
+    std::unordered_map<const T *, node_type> m_entries;
+};
+
+// obs_map bounded to a fixed number of entries. Adding an entry to a full cache evicts the least recently used
+// one, and an entry is evicted as soon as its target is destroyed. Every operation is O(1): entries are kept in
+// a list ordered by use and indexed by target address. Same threading rules as obs_map.
+template <class T, class V>
+class obs_cache
+{
+public:
+    using node_type = obs_detail::keyed_node<obs_cache, T, V>;
+
+    explicit obs_cache(std::size_t capacity)
+        : m_capacity(capacity)
+    {
+        assert(capacity > 0);
+    }
+
+    ~obs_cache()
+    {
+        clear();
+    }
+
+    obs_cache(const obs_cache &) = delete;
+    obs_cache &operator=(const obs_cache &) = delete;
+
+    // Value of spKey, constructed from args if it has none, and marks it most recently used.
+    // Returns nullptr if spKey is null or being destroyed.
+    template <class... Args>
+    V *try_emplace(const std::shared_ptr<T> &spKey, Args &&...args)
+    {
+        if (spKey == nullptr)
+        {
+            return nullptr;
+        }
+        const T *pKey = spKey.get();
+        if (auto it = m_index.find(pKey); it != m_index.end())
+        {
+            if (it->second->is_live())
+            {
+                return touch(it->second);
+            }
+            // Left behind by a dead target at the same address
+            evict(it);
+        }
+        if (m_lru.size() >= m_capacity)
+        {
+            evict(m_index.find(m_lru.back().key()));
+        }
+        auto it = m_index.try_emplace(pKey).first;
+        try
+        {
+            m_lru.emplace_front(*this, pKey, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            m_index.erase(it);
+            throw;
+        }
+        it->second = m_lru.begin();
+        if (!m_lru.front().link(*spKey))
+        {
+            evict(it);
+            return nullptr;
+        }
+        return &m_lru.front().value();
+    }
+
+    // Value of the target at pKey, marked most recently used, or nullptr
+    V *find(const T *pKey) noexcept
+    {
+        auto it = m_index.find(pKey);
+        return it != m_index.end() && it->second->is_live() ? touch(it->second) : nullptr;
+    }
+
+    // Whether the target at pKey has an entry, without marking it used
+    bool contains(const T *pKey) const noexcept
+    {
+        auto it = m_index.find(pKey);
+        return it != m_index.end() && it->second->is_live();
+    }
+
+    // Erases the entry of the target at pKey and detaches from it. Returns whether there was one.
+    bool erase(const T *pKey)
+    {
+        auto it = m_index.find(pKey);
+        if (it == m_index.end())
+        {
+            return false;
+        }
+        const bool isLive = it->second->is_live();
+        evict(it);
+        return isLive;
+    }
+
+    // Erases every entry
+    void clear()
+    {
+        list_type evicted;
+        evicted.splice(evicted.begin(), m_lru);
+        m_index.clear();
+    }
+
+    // Number of entries, counting those a notification_batch has yet to evict
+    std::size_t size() const noexcept
+    {
+        return m_lru.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return m_lru.empty();
+    }
+
+    std::size_t capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    friend node_type;
+
+private:
+    using list_type = std::list<node_type>;
+    using index_type = std::unordered_map<const T *, typename list_type::iterator>;
+
+    V *touch(typename list_type::iterator it) noexcept
+    {
+        m_lru.splice(m_lru.begin(), m_lru, it);
+        return &it->value();
+    }
+
+    // The node is destroyed once the cache no longer refers to it, so a value whose destruction destroys
+    // other targets may evict their entries too
+    void evict(typename index_type::iterator it)
+    {
+        list_type evicted;
+        evicted.splice(evicted.begin(), m_lru, it->second);
+        m_index.erase(it);
+    }
+
+    void erase_dead(node_type &node)
+    {
+        evict(m_index.find(node.key()));
+    }
+
+    // Most recently used first
+    list_type m_lru;
+    index_type m_index;
+    std::size_t m_capacity;
+};
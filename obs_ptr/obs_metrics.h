@@ -0,0 +1,280 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Metrics are opt-in. Define OBS_PTR_METRICS to 1 (or configure CMake with OBS_PTR_METRICS=ON) to count
+// attaches, detaches and notifications and to record registry sizes and teardown latency. When disabled
+// every hook compiles away and snapshots are all zero. Every translation unit must agree on the setting.
+#ifndef OBS_PTR_METRICS
+#define OBS_PTR_METRICS 0
+#endif
+
+// Buckets are powers of two: bucket 0 holds 0, bucket i holds values in [2^(i-1), 2^i)
+inline constexpr std::size_t obs_histogram_buckets = 65;
+
+struct obs_metrics_snapshot
+{
+    std::uint64_t attaches = 0;
+    std::uint64_t detaches = 0;
+    std::uint64_t notifications = 0;
+    std::uint64_t callbacks = 0;
+    // Notifications collected by a notification_batch instead of delivered at once
+    std::uint64_t deferred = 0;
+    std::uint64_t targets_destroyed = 0;
+    // Largest registry any single target has had
+    std::uint64_t peak_observers = 0;
+    // Destroyed targets by the peak size of their registry
+    std::array<std::uint64_t, obs_histogram_buckets> peak_observers_histogram{};
+    // Destroyed targets by time spent notifying their observers, in nanoseconds
+    std::array<std::uint64_t, obs_histogram_buckets> teardown_ns_histogram{};
+};
+
+namespace obs_detail
+{
+inline constexpr bool metrics_enabled = OBS_PTR_METRICS != 0;
+
+inline std::size_t histogram_bucket(std::uint64_t value) noexcept
+{
+    return static_cast<std::size_t>(std::bit_width(value));
+}
+
+// Counters of one thread. Only the owning thread writes them (plain load and store, no locked instructions),
+// snapshots read them from any thread.
+struct metrics_shard
+{
+    using counter = std::atomic<std::uint64_t>;
+
+    static void bump(counter &c, std::uint64_t n = 1) noexcept
+    {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void add_to(obs_metrics_snapshot &snapshot) const noexcept
+    {
+        snapshot.attaches += attaches.load(std::memory_order_relaxed);
+        snapshot.detaches += detaches.load(std::memory_order_relaxed);
+        snapshot.notifications += notifications.load(std::memory_order_relaxed);
+        snapshot.callbacks += callbacks.load(std::memory_order_relaxed);
+        snapshot.deferred += deferred.load(std::memory_order_relaxed);
+        snapshot.targets_destroyed += targetsDestroyed.load(std::memory_order_relaxed);
+        auto peak = peakObservers.load(std::memory_order_relaxed);
+        snapshot.peak_observers = peak > snapshot.peak_observers ? peak : snapshot.peak_observers;
+        for (std::size_t i = 0; i < obs_histogram_buckets; ++i)
+        {
+            snapshot.peak_observers_histogram[i] += peakHistogram[i].load(std::memory_order_relaxed);
+            snapshot.teardown_ns_histogram[i] += teardownHistogram[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    counter attaches{0};
+    counter detaches{0};
+    counter notifications{0};
+    counter callbacks{0};
+    counter deferred{0};
+    counter targetsDestroyed{0};
+    counter peakObservers{0};
+    std::array<counter, obs_histogram_buckets> peakHistogram{};
+    std::array<counter, obs_histogram_buckets> teardownHistogram{};
+    metrics_shard *pNext = nullptr;
+};
+
+// Live shards of all threads, plus the totals of threads that have exited
+class metrics_registry
+{
+public:
+    static metrics_registry &instance()
+    {
+        static metrics_registry s_registry;
+        return s_registry;
+    }
+
+    void attach(metrics_shard &shard)
+    {
+        std::lock_guard lock(m_mutex);
+        shard.pNext = m_pShards;
+        m_pShards = &shard;
+    }
+
+    void detach(metrics_shard &shard)
+    {
+        std::lock_guard lock(m_mutex);
+        shard.add_to(m_retired);
+        for (auto ppShard = &m_pShards; *ppShard != nullptr; ppShard = &(*ppShard)->pNext)
+        {
+            if (*ppShard == &shard)
+            {
+                *ppShard = shard.pNext;
+                break;
+            }
+        }
+    }
+
+    obs_metrics_snapshot snapshot()
+    {
+        std::lock_guard lock(m_mutex);
+        obs_metrics_snapshot result = m_retired;
+        for (auto pShard = m_pShards; pShard != nullptr; pShard = pShard->pNext)
+        {
+            pShard->add_to(result);
+        }
+        return result;
+    }
+
+private:
+    std::mutex m_mutex;
+    metrics_shard *m_pShards = nullptr;
+    obs_metrics_snapshot m_retired;
+};
+
+struct thread_metrics
+{
+    thread_metrics()
+    {
+        metrics_registry::instance().attach(shard);
+    }
+
+    ~thread_metrics()
+    {
+        metrics_registry::instance().detach(shard);
+    }
+
+    metrics_shard shard;
+};
+
+inline metrics_shard &local_metrics()
+{
+    static thread_local thread_metrics s_metrics;
+    return s_metrics.shard;
+}
+
+// Peak registry size of one target. Empty, and free under [[no_unique_address]], when metrics are disabled.
+template <bool Enabled = metrics_enabled>
+struct observer_peak
+{
+    void update(std::size_t) noexcept
+    {
+    }
+
+    std::size_t value() const noexcept
+    {
+        return 0;
+    }
+};
+
+template <>
+struct observer_peak<true>
+{
+    void update(std::size_t size) noexcept
+    {
+        m_peak = size > m_peak ? size : m_peak;
+    }
+
+    std::size_t value() const noexcept
+    {
+        return m_peak;
+    }
+
+    std::size_t m_peak = 0;
+};
+} // namespace obs_detail
+
+// Hook points used by the library, no-ops unless OBS_PTR_METRICS is enabled
+namespace obs_metrics
+{
+inline void count_attach(std::size_t registrySize) noexcept
+{
+    if constexpr (obs_detail::metrics_enabled)
+    {
+        auto &shard = obs_detail::local_metrics();
+        obs_detail::metrics_shard::bump(shard.attaches);
+        if (registrySize > shard.peakObservers.load(std::memory_order_relaxed))
+        {
+            shard.peakObservers.store(registrySize, std::memory_order_relaxed);
+        }
+    }
+}
+
+inline void count_detach() noexcept
+{
+    if constexpr (obs_detail::metrics_enabled)
+    {
+        obs_detail::metrics_shard::bump(obs_detail::local_metrics().detaches);
+    }
+}
+
+inline void count_notification() noexcept
+{
+    if constexpr (obs_detail::metrics_enabled)
+    {
+        obs_detail::metrics_shard::bump(obs_detail::local_metrics().notifications);
+    }
+}
+
+inline void count_callback() noexcept
+{
+    if constexpr (obs_detail::metrics_enabled)
+    {
+        obs_detail::metrics_shard::bump(obs_detail::local_metrics().callbacks);
+    }
+}
+
+inline void count_deferred() noexcept
+{
+    if constexpr (obs_detail::metrics_enabled)
+    {
+        obs_detail::metrics_shard::bump(obs_detail::local_metrics().deferred);
+    }
+}
+
+// Times one target's teardown and records it when destroyed
+class teardown_timer
+{
+public:
+    explicit teardown_timer(const obs_detail::observer_peak<> &peak) noexcept
+        : m_peak(peak)
+    {
+        if constexpr (obs_detail::metrics_enabled)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~teardown_timer()
+    {
+        if constexpr (obs_detail::metrics_enabled)
+        {
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+            auto &shard = obs_detail::local_metrics();
+            obs_detail::metrics_shard::bump(shard.targetsDestroyed);
+            obs_detail::metrics_shard::bump(shard.peakHistogram[obs_detail::histogram_bucket(m_peak.value())]);
+            obs_detail::metrics_shard::bump(shard.teardownHistogram[obs_detail::histogram_bucket(static_cast<std::uint64_t>(elapsed.count()))]);
+        }
+    }
+
+    teardown_timer(const teardown_timer &) = delete;
+    teardown_timer &operator=(const teardown_timer &) = delete;
+
+private:
+    [[maybe_unused]] const obs_detail::observer_peak<> &m_peak;
+    [[maybe_unused]] std::chrono::steady_clock::time_point m_start;
+};
+
+// Totals over all threads since program start. Compute differences of two snapshots for rates.
+inline obs_metrics_snapshot snapshot()
+{
+    if constexpr (obs_detail::metrics_enabled)
+    {
+        return obs_detail::metrics_registry::instance().snapshot();
+    }
+    return {};
+}
+} // namespace obs_metrics
@@ -0,0 +1,244 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cassert>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserver.h"
+#include "obs_callback.h"
+
+// ========================
+// Forward Declarations
+// ========================
+class obs_mailbox;
+
+// Compile-time policies of obs_ptr<T, Policies...>. Policies may be given in any order, each kind at most once:
+//
+//     checking   what dereferencing an unset observer does: obs_check_assert (default), obs_check_throw, obs_check_none
+//     storage    what the observer keeps besides the back-link: obs_store_weak (default), obs_store_link
+//     delivery   where the callback runs: obs_deliver_inline (default), obs_deliver_home
+//     callback   any type that is not a policy, invoked when the target is destroyed: obs_callback<> (default),
+//                obs_callback<N>, std::function<void()>, or no_callback
+//
+// obs_ptr<T> is the default set. Threading is not a per-observer policy: a target's registry is shared by observers
+// of every policy set, so it is chosen for the whole program by OBS_PTR_THREAD_SAFE, which compiles to null locks.
+
+struct obs_policy
+{
+};
+
+struct obs_check_policy : obs_policy
+{
+};
+
+struct obs_storage_policy : obs_policy
+{
+};
+
+struct obs_delivery_policy : obs_policy
+{
+};
+
+// Thrown by obs_check_throw when an unset observer is dereferenced
+class obs_bad_access : public std::logic_error
+{
+public:
+    obs_bad_access()
+        : std::logic_error("obs_ptr: dereferenced an unset or expired observer")
+    {
+    }
+};
+
+// Debug builds assert, release builds do not check
+struct obs_check_assert : obs_check_policy
+{
+    static constexpr bool is_nothrow = true;
+
+    static void check(const void *p) noexcept
+    {
+        assert(p != nullptr && "obs_ptr: dereferenced an unset or expired observer");
+        (void)p;
+    }
+};
+
+struct obs_check_throw : obs_check_policy
+{
+    static constexpr bool is_nothrow = false;
+
+    static void check(const void *p)
+    {
+        if (p == nullptr)
+        {
+            throw obs_bad_access();
+        }
+    }
+};
+
+struct obs_check_none : obs_check_policy
+{
+    static constexpr bool is_nothrow = true;
+
+    static void check(const void *) noexcept
+    {
+    }
+};
+
+// Keeps a weak_ptr to the target, for get_as_weak() and serialization
+struct obs_store_weak : obs_storage_policy
+{
+    static constexpr bool keeps_weak = true;
+
+    template <class T>
+    class holder
+    {
+    public:
+        void assign(const std::shared_ptr<T> &sp) noexcept
+        {
+            m_wp = sp;
+        }
+
+        void reset() noexcept
+        {
+            m_wp.reset();
+        }
+
+        const std::weak_ptr<T> &weak() const noexcept
+        {
+            return m_wp;
+        }
+
+    private:
+        std::weak_ptr<T> m_wp;
+    };
+};
+
+// Keeps nothing but the back-link, two pointers smaller. No get_as_weak() and no serialization.
+struct obs_store_link : obs_storage_policy
+{
+    static constexpr bool keeps_weak = false;
+
+    template <class T>
+    class holder
+    {
+    public:
+        void assign(const std::shared_ptr<T> &) noexcept
+        {
+        }
+
+        void reset() noexcept
+        {
+        }
+    };
+};
+
+// The callback runs on the thread destroying the target
+struct obs_deliver_inline : obs_delivery_policy
+{
+    static constexpr bool has_home = false;
+
+    class holder
+    {
+    public:
+        obs_detail::mail_node *mail() noexcept
+        {
+            return nullptr;
+        }
+    };
+};
+
+// The callback runs on the thread owning the observer's home obs_mailbox, when it drains the mailbox. Without a
+// home, or when the target dies on the home thread, it runs inline. See obs_mailbox.h.
+struct obs_deliver_home : obs_delivery_policy
+{
+    static constexpr bool has_home = true;
+
+    class holder
+    {
+    public:
+        holder() = default;
+
+        // The mail node belongs to its observer while it is posted, only the home is copied
+        holder(const holder &other) noexcept
+            : m_pHome(other.m_pHome)
+        {
+        }
+
+        holder &operator=(const holder &other) noexcept
+        {
+            m_pHome = other.m_pHome;
+            return *this;
+        }
+
+        obs_mailbox *get() const noexcept
+        {
+            return m_pHome;
+        }
+
+        void set(obs_mailbox *pHome) noexcept
+        {
+            m_pHome = pHome;
+        }
+
+        obs_detail::mail_node *mail() noexcept
+        {
+            return &m_mail;
+        }
+
+    private:
+        obs_mailbox *m_pHome = nullptr;
+        obs_detail::mail_node m_mail;
+    };
+};
+
+namespace obs_detail
+{
+template <class P>
+inline constexpr bool is_policy = std::is_base_of_v<obs_policy, P>;
+
+// First of Policies deriving from Kind, or Default
+template <class Kind, class Default, class... Policies>
+struct select_policy
+{
+    using type = Default;
+};
+
+template <class Kind, class Default, class P, class... Rest>
+struct select_policy<Kind, Default, P, Rest...>
+    : std::conditional_t<std::is_base_of_v<Kind, P>, std::type_identity<P>, select_policy<Kind, Default, Rest...>>
+{
+};
+
+// First of Policies that is not a policy, or Default
+template <class Default, class... Policies>
+struct select_callback
+{
+    using type = Default;
+};
+
+template <class Default, class P, class... Rest>
+struct select_callback<Default, P, Rest...>
+    : std::conditional_t<!is_policy<P>, std::type_identity<P>, select_callback<Default, Rest...>>
+{
+};
+
+template <class... Policies>
+struct policy_set
+{
+    static_assert((0 + ... + std::is_base_of_v<obs_check_policy, Policies>) <= 1, "More than one checking policy");
+    static_assert((0 + ... + std::is_base_of_v<obs_storage_policy, Policies>) <= 1, "More than one storage policy");
+    static_assert((0 + ... + std::is_base_of_v<obs_delivery_policy, Policies>) <= 1, "More than one delivery policy");
+    static_assert((0 + ... + !is_policy<Policies>) <= 1, "More than one callback type");
+
+    using check = typename select_policy<obs_check_policy, obs_check_assert, Policies...>::type;
+    using storage = typename select_policy<obs_storage_policy, obs_store_weak, Policies...>::type;
+    using delivery = typename select_policy<obs_delivery_policy, obs_deliver_inline, Policies...>::type;
+    using callback = typename select_callback<obs_callback<>, Policies...>::type;
+};
+} // namespace obs_detail
@@ -0,0 +1,145 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "obs_sync.h"
+
+// Fixed-size block pool for observer nodes. Every allocation of at most block_size bytes is served from a free
+// list refilled a chunk at a time from the upstream resource; anything larger goes to upstream directly. Freed
+// blocks are reused, chunks are only returned by release() or destruction.
+//
+//     obs_pool pool(obs_pool::node_size<obs_ptr<Enemy>>);
+//     auto spObserver = make_observer(std::pmr::polymorphic_allocator<>(&pool), spEnemy);
+//
+// For per-frame observers that are all dropped together, std::pmr::monotonic_buffer_resource works as well.
+class obs_pool : public std::pmr::memory_resource
+{
+public:
+    // Block size that fits an observer allocated together with its shared_ptr control block
+    template <class Observer>
+    static constexpr std::size_t node_size = sizeof(Observer) + 4 * sizeof(void *);
+
+    explicit obs_pool(std::size_t blockSize, std::size_t blocksPerChunk = 256,
+                      std::pmr::memory_resource *pUpstream = std::pmr::get_default_resource())
+        : m_blockSize(round_up(blockSize < sizeof(free_block) ? sizeof(free_block) : blockSize)),
+          m_blocksPerChunk(blocksPerChunk > 0 ? blocksPerChunk : 1),
+          m_pUpstream(pUpstream)
+    {
+    }
+
+    ~obs_pool() override
+    {
+        release();
+    }
+
+    obs_pool(const obs_pool &) = delete;
+    obs_pool &operator=(const obs_pool &) = delete;
+
+    // Returns every chunk to upstream. Blocks handed out before must no longer be in use.
+    void release() noexcept
+    {
+        std::lock_guard lock(m_lock);
+        while (m_pChunks != nullptr)
+        {
+            chunk *pNext = m_pChunks->pNext;
+            m_pUpstream->deallocate(m_pChunks, chunk_bytes(), alignof(std::max_align_t));
+            m_pChunks = pNext;
+        }
+        m_pFree = nullptr;
+    }
+
+    std::size_t block_size() const noexcept
+    {
+        return m_blockSize;
+    }
+
+private:
+    struct free_block
+    {
+        free_block *pNext;
+    };
+
+    struct alignas(std::max_align_t) chunk
+    {
+        chunk *pNext;
+    };
+
+    static constexpr std::size_t round_up(std::size_t bytes) noexcept
+    {
+        constexpr std::size_t align = alignof(std::max_align_t);
+        return (bytes + align - 1) / align * align;
+    }
+
+    std::size_t chunk_bytes() const noexcept
+    {
+        return sizeof(chunk) + m_blockSize * m_blocksPerChunk;
+    }
+
+    bool fits(std::size_t bytes, std::size_t alignment) const noexcept
+    {
+        return bytes <= m_blockSize && alignment <= alignof(std::max_align_t);
+    }
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (!fits(bytes, alignment))
+        {
+            return m_pUpstream->allocate(bytes, alignment);
+        }
+        std::lock_guard lock(m_lock);
+        if (m_pFree == nullptr)
+        {
+            refill();
+        }
+        free_block *pBlock = m_pFree;
+        m_pFree = pBlock->pNext;
+        return pBlock;
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        if (!fits(bytes, alignment))
+        {
+            m_pUpstream->deallocate(p, bytes, alignment);
+            return;
+        }
+        std::lock_guard lock(m_lock);
+        auto pBlock = static_cast<free_block *>(p);
+        pBlock->pNext = m_pFree;
+        m_pFree = pBlock;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void refill()
+    {
+        auto pChunk = static_cast<chunk *>(m_pUpstream->allocate(chunk_bytes(), alignof(std::max_align_t)));
+        pChunk->pNext = m_pChunks;
+        m_pChunks = pChunk;
+        auto pBlocks = reinterpret_cast<unsigned char *>(pChunk + 1);
+        for (std::size_t i = m_blocksPerChunk; i-- > 0;)
+        {
+            auto pBlock = reinterpret_cast<free_block *>(pBlocks + i * m_blockSize);
+            pBlock->pNext = m_pFree;
+            m_pFree = pBlock;
+        }
+    }
+
+    const std::size_t m_blockSize;
+    const std::size_t m_blocksPerChunk;
+    std::pmr::memory_resource *m_pUpstream;
+    chunk *m_pChunks = nullptr;
+    free_block *m_pFree = nullptr;
+    obs_detail::lock_type m_lock;
+};
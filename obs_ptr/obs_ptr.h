@@ -3,7 +3,13 @@
 // ========================
 // Standard Library Includes
 // ========================
+#include <cstddef>
+#include <iterator>
 #include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // ========================
 // Third-Party Library Includes
@@ -16,6 +22,13 @@
 // ========================
 #include "IObserved.h"
 #include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_await.h"
+#include "obs_callback.h"
+#include "obs_hazard.h"
+#include "obs_mailbox.h"
+#include "obs_policy.h"
+#include "obs_trace.h"
 
 // ========================
 // Namespace Usings
@@ -25,58 +38,191 @@
 // Forward Declarations
 // ========================
 
-template <class T>
-class obs_ptr : public IObserver, public std::enable_shared_from_this<obs_ptr<T>>
+// Policies select checking, storage, delivery and the callback type, see obs_policy.h. The callback is invoked when the
+// observed object is destroyed: obs_callback<> by default, obs_callback<N> for larger captures, no_callback for
+// observers that never need one. obs_ptr<T, Callback> therefore works as before.
+template <class T, class... Policies>
+class obs_ptr : public IObserver
 {
+    using policies = obs_detail::policy_set<Policies...>;
+
 public:
+    using callback_type = typename policies::callback;
+    using check_policy = typename policies::check;
+    using storage_policy = typename policies::storage;
+    using delivery_policy = typename policies::delivery;
+
+    static constexpr bool has_callback = !std::is_same_v<callback_type, no_callback>;
+
     obs_ptr()
     {
         // Does nothing
     }
 
+    explicit obs_ptr(const std::shared_ptr<T> &spObserved)
+    {
+        add_observer(spObserved);
+    }
+
+    obs_ptr(const std::shared_ptr<T> &spObserved, callback_type cb)
+        requires has_callback
+        : m_cb(std::move(cb))
+    {
+        add_observer(spObserved);
+    }
+
     ~obs_ptr()
     {
         remove_on_destruction();
     }
 
-    obs_ptr(const obs_ptr<T> &pOther) = delete;
+    // Copies observe the same object but do not copy the callback.
+    // Callbacks usually refer to the owner of the original observer.
+    obs_ptr(const obs_ptr &other)
+        : IObserver(other)
+    {
+        hook_guard guardOther(other);
+        hook_guard guard(*this);
+        copy_observation(other);
+    }
+
+    // Takes over the registration of other in O(1), other is left unset
+    obs_ptr(obs_ptr &&other) noexcept
+        : IObserver(other)
+    {
+        hook_guard guardOther(other, true);
+        hook_guard guard(*this);
+        m_cb = std::exchange(other.m_cb, {});
+        m_home = std::exchange(other.m_home, {});
+        move_observation(other);
+    }
 
-    obs_ptr(obs_ptr<T> &&other) noexcept = delete;
+    obs_ptr &operator=(const obs_ptr &other)
+    {
+        if (this != &other)
+        {
+            hook_guard guard(*this);
+            hook_guard guardOther(other);
+            unlink();
+            copy_observation(other);
+        }
+        return *this;
+    }
+
+    obs_ptr &operator=(obs_ptr &&other) noexcept
+    {
+        if (this != &other)
+        {
+            hook_guard guard(*this);
+            hook_guard guardOther(other, true);
+            unlink_and_cancel();
+            m_cb = std::exchange(other.m_cb, {});
+            callback_changed();
+            m_home = std::exchange(other.m_home, {});
+            move_observation(other);
+        }
+        return *this;
+    }
+
+    // Comparisons, is_set and get read the back-link only, which the target nulls when it is destroyed.
+    // No weak_ptr is locked, so none of them touch a reference count.
 
     bool operator!=(std::nullptr_t) const noexcept
     {
-        return m_wpObserved.lock() != nullptr;
+        return observed_link() != nullptr;
     }
 
-    bool operator!=(std::shared_ptr<T> sp) const noexcept
+    bool operator!=(const std::shared_ptr<T> &sp) const noexcept
     {
-        return m_wpObserved.lock() != sp;
+        return get() != sp.get();
     }
 
-    bool operator!=(const obs_ptr<T> &other) const noexcept
+    bool operator!=(const obs_ptr &other) const noexcept
     {
-        return m_wpObserved.lock() != other.m_wpObserved.lock();
+        return observed_link() != other.observed_link();
     }
 
     bool operator==(std::nullptr_t) const noexcept
     {
-        return m_wpObserved.lock() == nullptr;
+        return observed_link() == nullptr;
+    }
+
+    bool operator==(const std::shared_ptr<T> &sp) const noexcept
+    {
+        return get() == sp.get();
+    }
+
+    bool operator==(const obs_ptr &other) const noexcept
+    {
+        return observed_link() == other.observed_link();
+    }
+
+    // Observed object, or nullptr once it is destroyed. In thread-safe mode the pointer is only safe to
+    // dereference while the caller otherwise knows the target is alive; use get_as_weak().lock() otherwise.
+    T *get() const noexcept
+    {
+        return static_cast<T *>(observed_link());
+    }
+
+    T *operator->() const noexcept(check_policy::is_nothrow)
+    {
+        T *p = get();
+        check_policy::check(p);
+        return p;
+    }
+
+    T &operator*() const noexcept(check_policy::is_nothrow)
+    {
+        T *p = get();
+        check_policy::check(p);
+        return *p;
+    }
+
+    // co_await ptr.destroyed() suspends the coroutine until the target is destroyed. It resumes inline in the
+    // destroying thread, or through executor(std::coroutine_handle<>) when one is given.
+    obs_destroyed_awaitable<obs_inline_executor, 1> destroyed() const
+    {
+        return {obs_inline_executor{}, {this}};
     }
 
-    bool operator==(std::shared_ptr<T> sp) const noexcept
+    template <class Executor>
+    obs_destroyed_awaitable<Executor, 1> destroyed(Executor executor) const
     {
-        return m_wpObserved.lock() == sp;
+        return {std::move(executor), {this}};
     }
 
-    bool operator==(const obs_ptr<T> &other) const noexcept
+    // Dereference safe across threads without touching the target's reference count. The target cannot be
+    // deleted while the returned pin exists, provided it was created by make_observed. Empty if unset.
+    obs_pin<T> pin() const
     {
-        return m_wpObserved.lock() == other.m_wpObserved.lock();
+        if (observed_link() == nullptr)
+        {
+            return {};
+        }
+        auto &record = obs_detail::hazard_record_cache::acquire();
+        for (;;)
+        {
+            IObserved *pObserved = observed_link();
+            if (pObserved == nullptr)
+            {
+                obs_detail::hazard_record_cache::release(record);
+                return {};
+            }
+            record.pProtected.store(pObserved, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // Still linked after publishing, so the target had not been retired yet and now waits for us
+            if (observed_link() == pObserved)
+            {
+                return obs_pin<T>(static_cast<T *>(pObserved), record);
+            }
+        }
     }
 
-    void set(const std::shared_ptr<T> &pOther, std::function<void()> cb)
+    void set(const std::shared_ptr<T> &pOther, callback_type cb)
+        requires has_callback
     {
         add_observer(pOther);
-        set_cb(cb);
+        set_cb(std::move(cb));
     }
 
     void set(const std::shared_ptr<T> &pOther)
@@ -90,157 +236,408 @@ public:
         unset_cb();
     }
 
-    void set_cb(std::function<void()> cb)
+    void set_cb(callback_type cb)
+        requires has_callback
     {
-        m_cb = cb;
+        hook_guard guard(*this);
+        m_cb = std::move(cb);
+        callback_changed();
     }
 
     void unset_cb()
     {
-        m_cb = {};
+        if constexpr (has_callback)
+        {
+            hook_guard guard(*this);
+            m_cb = {};
+            callback_changed();
+        }
+    }
+
+    // Runs the callback on the thread owning pHome when the target dies on another thread, see obs_mailbox.h.
+    // Null runs it inline again. Copies do not inherit the home, moves take it along with the callback.
+    void set_home(obs_mailbox *pHome)
+        requires delivery_policy::has_home
+    {
+        hook_guard guard(*this);
+        m_home.set(pHome);
+    }
+
+    obs_mailbox *home() const
+        requires delivery_policy::has_home
+    {
+        hook_guard guard(*this);
+        return m_home.get();
     }
 
-    bool is_set() const
+    bool is_set() const noexcept
     {
-        return !m_wpObserved.expired() && m_wpObserved.lock() != nullptr;
+        return observed_link() != nullptr;
     }
 
     std::weak_ptr<T> get_as_weak() noexcept
+        requires storage_policy::keeps_weak
     {
-        return m_wpObserved;
+        return m_store.weak();
     }
 
-    obs_ptr<T> &get_obs()
+    obs_ptr &get_obs()
     {
         return *this;
     }
 
-    template <class U>
-    friend std::shared_ptr<obs_ptr<U>> make_observer(std::shared_ptr<U> spObserved, std::function<void()> cb);
+    // count observers of spObserved in one contiguous allocation, registered with it in a single pass under one
+    // lock. Each gets a copy of cb. All of them are unset if spObserved is null or already being destroyed.
+    static std::vector<obs_ptr> observe_all(const std::shared_ptr<T> &spObserved, std::size_t count)
+    {
+        return make_all(spObserved, count, [](obs_ptr &) {});
+    }
 
-    template <class U>
-    friend std::shared_ptr<obs_ptr<U>> copy_observer(std::shared_ptr<obs_ptr<U>> spObserver, std::function<void()> cb);
+    template <class F>
+        requires has_callback
+    static std::vector<obs_ptr> observe_all(const std::shared_ptr<T> &spObserved, std::size_t count, const F &cb)
+    {
+        return make_all(spObserved, count, [&cb](obs_ptr &observer)
+                        { observer.m_cb = callback_type(cb); });
+    }
 
-    template <class U>
-    friend std::shared_ptr<obs_ptr<U>> move_observer(std::shared_ptr<obs_ptr<U>> spObserver, std::function<void()> cb);
+    // One observer per target, in one contiguous allocation and in the order of targets. Null targets give
+    // unset observers. Each gets a copy of cb.
+    template <class Range>
+    static std::vector<obs_ptr> observe_each(const Range &targets)
+    {
+        return make_each(targets, [](obs_ptr &) {});
+    }
+
+    template <class Range, class F>
+        requires has_callback
+    static std::vector<obs_ptr> observe_each(const Range &targets, const F &cb)
+    {
+        return make_each(targets, [&cb](obs_ptr &observer)
+                         { observer.m_cb = callback_type(cb); });
+    }
 
     template <class Archive>
     void serialize(Archive &ar)
+        requires storage_policy::keeps_weak
     {
-        ar(m_wpObserved);
+        if constexpr (Archive::is_loading::value)
+        {
+            std::weak_ptr<T> wpLoaded;
+            ar(wpLoaded);
+            add_observer(wpLoaded.lock());
+        }
+        else
+        {
+            ar(m_store.weak());
+        }
     }
 
+    friend class IObserver;
+
 protected:
-    void handle_notification() override
+    // Called with the hook lock held by the notifying IObserved, which the callback runs without
+    void handle_notification() final
     {
-        if (m_cb)
+        if constexpr (delivery_policy::has_home && has_callback)
+        {
+            obs_mailbox *pHome = m_home.get();
+            if (pHome != nullptr && m_cb && !pHome->is_home_thread())
+            {
+                // Already nulled. We are notified again on the home thread when it drains the mailbox.
+                pHome->post(*this, *m_home.mail());
+                return;
+            }
+        }
+        if constexpr (has_callback)
+        {
+            obs_trace::notification(this, static_cast<bool>(m_cb));
+        }
+        else
+        {
+            obs_trace::notification(this, false);
+        }
+        if constexpr (!obs_detail::thread_safe)
+        {
+            // In thread-safe mode m_store belongs to the owning thread. It has expired
+            // anyway and is released by the next set, unset or destruction.
+            // A notification deferred by a notification_batch may arrive after we were set to something new.
+            if (observed_link() == nullptr)
+            {
+                m_store.reset();
+            }
+        }
+        // The callback may destroy this observer (e.g. by resetting the owner's handle), so it must be the last thing we do
+        if constexpr (has_callback)
         {
-            m_cb();
+            if (m_cb)
+            {
+                obs_metrics::count_callback();
+                invoke_callback(m_cb);
+            }
         }
-        m_wpObserved.reset();
     }
 
 private:
-    void add_observer(std::shared_ptr<T> spNewObserved)
+    // The observers are not visible to other threads yet, so they are registered without their hook_guards
+    template <class Init>
+    static std::vector<obs_ptr> make_all(const std::shared_ptr<T> &spObserved, std::size_t count, Init &&init)
     {
-        if (spNewObserved == m_wpObserved.lock())
+        std::vector<obs_ptr> observers(count);
+        for (auto &observer : observers)
+        {
+            init(observer);
+        }
+        if (spObserved != nullptr && static_cast<IObserved &>(*spObserved).add_observers(observers.data(), count))
+        {
+            for (auto &observer : observers)
+            {
+                observer.m_store.assign(spObserved);
+            }
+        }
+        return observers;
+    }
+
+    template <class Range, class Init>
+    static std::vector<obs_ptr> make_each(const Range &targets, Init &&init)
+    {
+        std::vector<obs_ptr> observers(static_cast<std::size_t>(std::ranges::distance(targets)));
+        auto it = observers.begin();
+        for (const std::shared_ptr<T> &spObserved : targets)
+        {
+            obs_ptr &observer = *it++;
+            init(observer);
+            if (spObserved != nullptr && static_cast<IObserved &>(*spObserved).add_observer(observer))
+            {
+                observer.m_store.assign(spObserved);
+            }
+        }
+        return observers;
+    }
+
+    void add_observer(const std::shared_ptr<T> &spNewObserved)
+    {
+        hook_guard guard(*this);
+        link_to(spNewObserved);
+    }
+
+    void remove_observer()
+    {
+        hook_guard guard(*this);
+        unlink_and_cancel();
+    }
+
+    // Functions below require the hook_guard of every observer involved to be held
+
+    void link_to(const std::shared_ptr<T> &spNewObserved)
+    {
+        if (static_cast<IObserved *>(spNewObserved.get()) == observed_link())
         {
             // Do not set to observe same object
             return;
         }
-        remove_observer();
+        unlink();
         if (spNewObserved == nullptr)
         {
             // Nothing more if set to nullptr
             return;
         }
-        auto spThis = this->shared_from_this();
-        spNewObserved->add_observer(spThis);
-        m_wpObserved = spNewObserved;
+        if (static_cast<IObserved &>(*spNewObserved).add_observer(*this))
+        {
+            m_store.assign(spNewObserved);
+        }
     }
 
-    void remove_observer()
+    void unlink()
     {
-        auto spObserved = m_wpObserved.lock();
-        if (spObserved == nullptr)
+        if (auto pObserved = observed_link())
         {
-            return;
+            pObserved->remove_observer(*this);
         }
-        spObserved->remove_observer(this->std::enable_shared_from_this<obs_ptr<T>>::shared_from_this());
-        m_wpObserved.reset();
+        m_store.reset();
     }
 
-    // Destructor-safe
+    void unlink_and_cancel()
+    {
+        unlink();
+        notification_batch::cancel(*this, m_home.mail());
+    }
+
+    void copy_observation(const obs_ptr &other)
+    {
+        // other's lock keeps its target alive while we register
+        auto pObserved = other.observed_link();
+        if (pObserved != nullptr && pObserved->add_observer(*this))
+        {
+            m_store = other.m_store;
+        }
+    }
+
+    void move_observation(obs_ptr &other) noexcept
+    {
+        if (auto pObserved = other.observed_link())
+        {
+            pObserved->relocate_observer(other, *this);
+        }
+        m_store = std::move(other.m_store);
+        // A deferred notification travels with the callback
+        notification_batch::relocate(other, *this, other.m_home.mail(), m_home.mail());
+    }
+
+    // Destructor-safe. The back-link is nulled by the observed object when it is destroyed,
+    // so a non-null link always refers to a live object.
     void remove_on_destruction()
     {
-        auto pObserved = m_wpObserved.lock();
-        if (pObserved == nullptr)
+        if (!begin_teardown())
         {
             return;
         }
-        // Only remove expired pointers, does not forward a shared_from_this
-        pObserved->remove_destructed_observer();
+        hook_guard guard(*this, true);
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        notification_batch::cancel(*this, m_home.mail());
     }
 
-    std::weak_ptr<T> m_wpObserved;
-    std::function<void()> m_cb;
+    [[no_unique_address]] typename storage_policy::template holder<T> m_store;
+    [[no_unique_address]] callback_type m_cb;
+    [[no_unique_address]] typename delivery_policy::holder m_home;
 };
 
 // nullptr on lhs
-template <class T>
-inline bool operator==(std::nullptr_t, const obs_ptr<T> &rhs) noexcept
+template <class T, class... Policies>
+inline bool operator==(std::nullptr_t, const obs_ptr<T, Policies...> &rhs) noexcept
 {
     return rhs == nullptr;
 }
 
-template <class T>
-inline bool operator!=(std::nullptr_t, const obs_ptr<T> &rhs) noexcept
+template <class T, class... Policies>
+inline bool operator!=(std::nullptr_t, const obs_ptr<T, Policies...> &rhs) noexcept
 {
     return rhs != nullptr;
 }
 
 // shared_ptr<T> on lhs
-template <class T>
-inline bool operator==(const std::shared_ptr<T> &lhs, const obs_ptr<T> &rhs) noexcept
+template <class T, class... Policies>
+inline bool operator==(const std::shared_ptr<T> &lhs, const obs_ptr<T, Policies...> &rhs) noexcept
 {
     return rhs == lhs;
 }
 
-template <class T>
-inline bool operator!=(const std::shared_ptr<T> &lhs, const obs_ptr<T> &rhs) noexcept
+template <class T, class... Policies>
+inline bool operator!=(const std::shared_ptr<T> &lhs, const obs_ptr<T, Policies...> &rhs) noexcept
 {
     return rhs != lhs;
 }
 
-template <class T>
-std::shared_ptr<obs_ptr<T>> make_observer(std::shared_ptr<T> spObserved = nullptr, std::function<void()> cb = {})
+// The callback is not deduced from the argument, a lambda converts to the observer's callback type
+template <class T, class... Policies>
+std::shared_ptr<obs_ptr<T, Policies...>> make_observer(std::shared_ptr<T> spObserved = nullptr, typename obs_ptr<T, Policies...>::callback_type cb = {})
+{
+    if constexpr (obs_ptr<T, Policies...>::has_callback)
+    {
+        return std::make_shared<obs_ptr<T, Policies...>>(spObserved, std::move(cb));
+    }
+    else
+    {
+        return std::make_shared<obs_ptr<T, Policies...>>(spObserved);
+    }
+}
+
+// Observer and control block are allocated together through alloc, e.g. a polymorphic_allocator over an obs_pool
+template <class T, class... Policies, class Alloc>
+    requires requires { typename Alloc::value_type; }
+std::shared_ptr<obs_ptr<T, Policies...>> make_observer(const Alloc &alloc, std::shared_ptr<T> spObserved = nullptr, typename obs_ptr<T, Policies...>::callback_type cb = {})
 {
-    auto pObserver = std::make_shared<obs_ptr<T>>();
-    pObserver->set_cb(cb);
-    pObserver->add_observer(spObserved);
-    return std::move(pObserver);
+    if constexpr (obs_ptr<T, Policies...>::has_callback)
+    {
+        return std::allocate_shared<obs_ptr<T, Policies...>>(alloc, spObserved, std::move(cb));
+    }
+    else
+    {
+        return std::allocate_shared<obs_ptr<T, Policies...>>(alloc, spObserved);
+    }
 }
 
-template <class T>
-std::shared_ptr<obs_ptr<T>> copy_observer(std::shared_ptr<obs_ptr<T>> spObserver, std::function<void()> cb = {})
+template <class T, class... Policies>
+std::shared_ptr<obs_ptr<T, Policies...>> copy_observer(std::shared_ptr<obs_ptr<T, Policies...>> spObserver, typename obs_ptr<T, Policies...>::callback_type cb = {})
 {
+    // Every copy registers with the target, having a callback of its own. share_observer shares one entry instead.
     // We must copy from something. Makes no sense otherwise
-    if (spObserver == nullptr)
+    if (!spObserver)
     {
         return nullptr;
     }
-    auto pObserver = make_observer(spObserver->m_wpObserved.lock());
-    pObserver->set_cb(cb);
-    return std::move(pObserver);
+    auto pObserver = std::make_shared<obs_ptr<T, Policies...>>(*spObserver);
+    if constexpr (obs_ptr<T, Policies...>::has_callback)
+    {
+        pObserver->set_cb(std::move(cb));
+    }
+    return pObserver;
+}
+
+template <class T, class... Policies>
+std::shared_ptr<obs_ptr<T, Policies...>> move_observer(std::shared_ptr<obs_ptr<T, Policies...>> spObserver, typename obs_ptr<T, Policies...>::callback_type cb = {})
+{
+    // Relocates the registration, the target's observer count does not change
+    auto pObserver = std::make_shared<obs_ptr<T, Policies...>>(std::move(*spObserver));
+    if constexpr (obs_ptr<T, Policies...>::has_callback)
+    {
+        pObserver->set_cb(std::move(cb));
+    }
+    return pObserver;
 }
 
-template <class T>
-std::shared_ptr<obs_ptr<T>> move_observer(std::shared_ptr<obs_ptr<T>> spObserver, std::function<void()> cb = {})
+// observe_all<Policies...>(target, count, cb): count observers of target, allocated and registered in one go
+template <class... Policies, class T>
+std::vector<obs_ptr<T, Policies...>> observe_all(const std::shared_ptr<T> &spObserved, std::size_t count)
 {
-    auto pObserver = make_observer(spObserver->m_wpObserved.lock(), cb);
-    spObserver->unset();
-    return std::move(pObserver);
+    return obs_ptr<T, Policies...>::observe_all(spObserved, count);
 }
 
-template <typename T>
-using obs_sptr = std::shared_ptr<obs_ptr<T>>;
\ No newline at end of file
+template <class... Policies, class T, class F>
+std::vector<obs_ptr<T, Policies...>> observe_all(const std::shared_ptr<T> &spObserved, std::size_t count, const F &cb)
+{
+    return obs_ptr<T, Policies...>::observe_all(spObserved, count, cb);
+}
+
+// observe_each<Policies...>(targets, cb): one observer per shared_ptr in targets, allocated in one go
+template <class... Policies, class Range>
+std::vector<obs_ptr<typename std::ranges::range_value_t<Range>::element_type, Policies...>> observe_each(const Range &targets)
+{
+    return obs_ptr<typename std::ranges::range_value_t<Range>::element_type, Policies...>::observe_each(targets);
+}
+
+template <class... Policies, class Range, class F>
+std::vector<obs_ptr<typename std::ranges::range_value_t<Range>::element_type, Policies...>> observe_each(const Range &targets, const F &cb)
+{
+    return obs_ptr<typename std::ranges::range_value_t<Range>::element_type, Policies...>::observe_each(targets, cb);
+}
+
+template <typename T, class... Policies>
+using obs_sptr = std::shared_ptr<obs_ptr<T, Policies...>>;
+
+// Comparisons on obs_sptr compare what is observed, not the observers themselves.
+// A null obs_sptr compares like an unset observer.
+template <class T, class... Policies>
+inline bool operator==(const obs_sptr<T, Policies...> &lhs, std::nullptr_t) noexcept
+{
+    return !lhs || *lhs == nullptr;
+}
+
+template <class T, class... Policies>
+inline bool operator==(const obs_sptr<T, Policies...> &lhs, const std::shared_ptr<T> &rhs) noexcept
+{
+    return lhs ? *lhs == rhs : rhs == nullptr;
+}
+
+template <class T, class... Policies>
+inline bool operator==(const obs_sptr<T, Policies...> &lhs, const obs_sptr<T, Policies...> &rhs) noexcept
+{
+    if (!lhs || !rhs)
+    {
+        return (lhs == nullptr) && (rhs == nullptr);
+    }
+    return *lhs == *rhs;
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_policy.h"
+#include "obs_ptr.h"
+#include "obs_sync.h"
+
+template <class T, class... Policies>
+class obs_shared;
+
+namespace obs_detail
+{
+// One registration with a target, shared by every obs_shared copied from the same handle. Deleted with the last.
+template <class T>
+class shared_node final : public IObserver
+{
+public:
+    shared_node() = default;
+
+    shared_node(const shared_node &) = delete;
+    shared_node &operator=(const shared_node &) = delete;
+
+    ~shared_node()
+    {
+        if (!begin_teardown())
+        {
+            return;
+        }
+        hook_guard guard(*this, true);
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        notification_batch::cancel(*this);
+    }
+
+    T *get() const noexcept
+    {
+        return static_cast<T *>(observed_link());
+    }
+
+    friend class IObserver;
+    template <class U, class... Policies>
+    friend class ::obs_shared;
+
+protected:
+    // Nothing to do, the link is already null and there is no callback
+    void handle_notification() final
+    {
+    }
+
+private:
+    void link(T *pObserved)
+    {
+        hook_guard guard(*this);
+        if (pObserved != nullptr)
+        {
+            static_cast<IObserved &>(*pObserved).add_observer(*this);
+        }
+    }
+
+    // Registers with the target of other, whose lock keeps it alive while we do
+    template <class... Policies>
+    void link_from(const obs_ptr<T, Policies...> &other)
+    {
+        hook_guard guardOther(other);
+        link(other.get());
+    }
+
+    std::conditional_t<thread_safe, std::atomic<std::size_t>, std::size_t> m_refs{1};
+};
+} // namespace obs_detail
+
+// Shared, callback-free observation of a target. Copies share one reference-counted node registered with the
+// target once, so handing an observation to many holders grows neither the target's registry nor the work of
+// its destruction. A handle is one pointer; reading it costs one indirection to the shared node. Observes a
+// single target for its lifetime: to observe another, assign a new handle.
+//
+// Takes a checking policy of obs_ptr. Copies and destruction are safe from any thread in thread-safe mode.
+template <class T, class... Policies>
+class obs_shared
+{
+    using policies = obs_detail::policy_set<Policies...>;
+    static_assert((std::is_base_of_v<obs_check_policy, Policies> && ...), "obs_shared takes a checking policy only");
+
+public:
+    using check_policy = typename policies::check;
+
+    obs_shared() noexcept = default;
+
+    explicit obs_shared(const std::shared_ptr<T> &spObserved)
+    {
+        if (spObserved != nullptr)
+        {
+            m_pNode = new node_type();
+            m_pNode->link(spObserved.get());
+        }
+    }
+
+    // Shares the target of an obs_ptr, which keeps its own registration and callback
+    template <class... ObserverPolicies>
+    explicit obs_shared(const obs_ptr<T, ObserverPolicies...> &observer)
+    {
+        if (observer.is_set())
+        {
+            m_pNode = new node_type();
+            m_pNode->link_from(observer);
+        }
+    }
+
+    ~obs_shared()
+    {
+        release();
+    }
+
+    obs_shared(const obs_shared &other) noexcept
+        : m_pNode(other.m_pNode)
+    {
+        if (m_pNode != nullptr)
+        {
+            ++m_pNode->m_refs;
+        }
+    }
+
+    obs_shared(obs_shared &&other) noexcept
+        : m_pNode(std::exchange(other.m_pNode, nullptr))
+    {
+    }
+
+    obs_shared &operator=(obs_shared other) noexcept
+    {
+        std::swap(m_pNode, other.m_pNode);
+        return *this;
+    }
+
+    bool operator==(std::nullptr_t) const noexcept
+    {
+        return get() == nullptr;
+    }
+
+    bool operator!=(std::nullptr_t) const noexcept
+    {
+        return get() != nullptr;
+    }
+
+    bool operator==(const std::shared_ptr<T> &sp) const noexcept
+    {
+        return get() == sp.get();
+    }
+
+    bool operator!=(const std::shared_ptr<T> &sp) const noexcept
+    {
+        return get() != sp.get();
+    }
+
+    bool operator==(const obs_shared &other) const noexcept
+    {
+        return get() == other.get();
+    }
+
+    bool operator!=(const obs_shared &other) const noexcept
+    {
+        return get() != other.get();
+    }
+
+    // Observed object, or nullptr once it is destroyed. Same thread-safety caveats as obs_ptr::get.
+    T *get() const noexcept
+    {
+        return m_pNode != nullptr ? m_pNode->get() : nullptr;
+    }
+
+    T *operator->() const noexcept(check_policy::is_nothrow)
+    {
+        T *p = get();
+        check_policy::check(p);
+        return p;
+    }
+
+    T &operator*() const noexcept(check_policy::is_nothrow)
+    {
+        T *p = get();
+        check_policy::check(p);
+        return *p;
+    }
+
+    bool is_set() const noexcept
+    {
+        return get() != nullptr;
+    }
+
+    // Number of handles sharing this one's node, 0 for an empty handle
+    std::size_t use_count() const noexcept
+    {
+        return m_pNode != nullptr ? static_cast<std::size_t>(m_pNode->m_refs) : 0;
+    }
+
+    // Drops this handle, the last one to go unregisters the node
+    void reset() noexcept
+    {
+        release();
+        m_pNode = nullptr;
+    }
+
+private:
+    using node_type = obs_detail::shared_node<T>;
+
+    void release() noexcept
+    {
+        if (m_pNode != nullptr && --m_pNode->m_refs == 0)
+        {
+            delete m_pNode;
+        }
+    }
+
+    node_type *m_pNode = nullptr;
+};
+
+// nullptr on lhs
+template <class T, class... Policies>
+inline bool operator==(std::nullptr_t, const obs_shared<T, Policies...> &rhs) noexcept
+{
+    return rhs == nullptr;
+}
+
+template <class T, class... Policies>
+inline bool operator!=(std::nullptr_t, const obs_shared<T, Policies...> &rhs) noexcept
+{
+    return rhs != nullptr;
+}
+
+// shared_ptr<T> on lhs
+template <class T, class... Policies>
+inline bool operator==(const std::shared_ptr<T> &lhs, const obs_shared<T, Policies...> &rhs) noexcept
+{
+    return rhs == lhs;
+}
+
+template <class T, class... Policies>
+inline bool operator!=(const std::shared_ptr<T> &lhs, const obs_shared<T, Policies...> &rhs) noexcept
+{
+    return rhs != lhs;
+}
+
+// Shared observation of the target of spObserver, the callback-free alternative to copy_observer. The result
+// registers its own node, since spObserver's entry goes away with spObserver, but every handle shared from it
+// costs the target no further registry entry.
+template <class T, class... Policies>
+obs_shared<T> share_observer(const std::shared_ptr<obs_ptr<T, Policies...>> &spObserver)
+{
+    return spObserver != nullptr ? obs_shared<T>(*spObserver) : obs_shared<T>();
+}
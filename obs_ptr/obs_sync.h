@@ -0,0 +1,248 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Thread-safe observation is opt-in. Define OBS_PTR_THREAD_SAFE to 1 (or configure CMake with
+// OBS_PTR_THREAD_SAFE=ON) to make attach, detach, move and destruction-time nulling safe from any thread.
+// Every translation unit of a program must agree on the setting.
+#ifndef OBS_PTR_THREAD_SAFE
+#define OBS_PTR_THREAD_SAFE 0
+#endif
+
+namespace obs_detail
+{
+inline constexpr bool thread_safe = OBS_PTR_THREAD_SAFE != 0;
+
+// Test-and-test-and-set lock guarding one registry or one observer's registration.
+// Unlock is a single release store: once the next owner has the lock, the previous owner never
+// touches it again, which allows a dying IObserved to release its lock right after acquiring it.
+class spin_lock
+{
+public:
+    void lock() noexcept
+    {
+        while (m_locked.exchange(true, std::memory_order_acquire))
+        {
+            while (m_locked.load(std::memory_order_relaxed))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() noexcept
+    {
+        m_locked.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> m_locked{false};
+};
+
+// Single-threaded stand-in, compiles away entirely
+class null_lock
+{
+public:
+    void lock() noexcept
+    {
+    }
+
+    bool try_lock() noexcept
+    {
+        return true;
+    }
+
+    void unlock() noexcept
+    {
+    }
+};
+
+using lock_type = std::conditional_t<thread_safe, spin_lock, null_lock>;
+
+// Number of threads running an observer's user code without its lock, which destruction and moves wait for
+class busy_count
+{
+public:
+    void enter() noexcept
+    {
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void leave() noexcept
+    {
+        m_count.fetch_sub(1, std::memory_order_release);
+    }
+
+    bool is_busy() const noexcept
+    {
+        return m_count.load(std::memory_order_acquire) != 0;
+    }
+
+private:
+    std::atomic<std::uint16_t> m_count{0};
+};
+
+// Single-threaded stand-in, never busy
+class null_busy
+{
+public:
+    void enter() noexcept
+    {
+    }
+
+    void leave() noexcept
+    {
+    }
+
+    bool is_busy() const noexcept
+    {
+        return false;
+    }
+};
+
+using busy_type = std::conditional_t<thread_safe, busy_count, null_busy>;
+
+// Word whose bit 0 is a spin lock, the other bits belong to the owner. lock() returns the word without the lock
+// bit, unlock() publishes the new value with a single release store, like spin_lock.
+class spin_word
+{
+public:
+    static constexpr std::uintptr_t locked_bit = 1;
+
+    explicit spin_word(std::uintptr_t value = 0) noexcept
+        : m_word(value)
+    {
+    }
+
+    std::uintptr_t lock() noexcept
+    {
+        for (;;)
+        {
+            std::uintptr_t word = m_word.load(std::memory_order_relaxed);
+            if ((word & locked_bit) == 0 &&
+                m_word.compare_exchange_weak(word, word | locked_bit, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return word;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock(std::uintptr_t word) noexcept
+    {
+        m_word.store(word & ~locked_bit, std::memory_order_release);
+    }
+
+private:
+    std::atomic<std::uintptr_t> m_word;
+};
+
+// Single-threaded stand-in, a plain word
+class plain_word
+{
+public:
+    explicit plain_word(std::uintptr_t value = 0) noexcept
+        : m_word(value)
+    {
+    }
+
+    std::uintptr_t lock() noexcept
+    {
+        return m_word;
+    }
+
+    void unlock(std::uintptr_t word) noexcept
+    {
+        m_word = word;
+    }
+
+private:
+    std::uintptr_t m_word;
+};
+
+using word_type = std::conditional_t<thread_safe, spin_word, plain_word>;
+
+// Hint that p is about to be written. No-op where unsupported.
+inline void prefetch(const void *p) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 1);
+#else
+    (void)p;
+#endif
+}
+
+// Pointer published with release/acquire ordering in thread-safe mode, a plain pointer otherwise
+template <class T, bool Atomic = thread_safe>
+class link_ptr
+{
+public:
+    T *load() const noexcept
+    {
+        return m_p;
+    }
+
+    void store(T *p) noexcept
+    {
+        m_p = p;
+    }
+
+private:
+    T *m_p = nullptr;
+};
+
+template <class T>
+class link_ptr<T, true>
+{
+public:
+    T *load() const noexcept
+    {
+        return m_p.load(std::memory_order_acquire);
+    }
+
+    void store(T *p) noexcept
+    {
+        m_p.store(p, std::memory_order_release);
+    }
+
+private:
+    std::atomic<T *> m_p{nullptr};
+};
+
+// In thread-safe mode an observer's registration lock is held by the notifying thread for the duration of
+// handle_notification, except while user code runs (see IObserver::run_unlocked). Frames record which observers
+// this thread is notifying, so that the observer can still be used (or destroyed) from its notification without
+// deadlocking on that lock.
+struct notification_frame
+{
+    const void *pObserver;
+    notification_frame *pOuter;
+    bool destroyed = false;
+    // The lock is released while user code runs
+    bool unlocked = false;
+};
+
+inline thread_local notification_frame *t_pNotificationFrame = nullptr;
+
+inline notification_frame *find_notification_frame(const void *pObserver) noexcept
+{
+    for (auto pFrame = t_pNotificationFrame; pFrame != nullptr; pFrame = pFrame->pOuter)
+    {
+        if (pFrame->pObserver == pObserver)
+        {
+            return pFrame;
+        }
+    }
+    return nullptr;
+}
+} // namespace obs_detail
@@ -0,0 +1,120 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <cstddef>
+
+// Static tracepoints at attach, detach, teardown and notification. There are two independent consumers:
+//
+// - A hook policy: define OBS_PTR_TRACE_HOOKS to the name of a type with the same static members as
+//   obs_no_trace, and OBS_PTR_TRACE_HOOKS_HEADER to the header declaring it (e.g. -DOBS_PTR_TRACE_HOOKS_HEADER=
+//   '"my_hooks.h"'). The library calls it directly, so an inline policy is inlined into the hot paths and the
+//   default one compiles to nothing. The policy is chosen once per program rather than per obs_ptr like the
+//   obs_*_policy types, because IObserved is not a template and a target's tracepoints serve observers of every
+//   policy set.
+// - USDT probes: define OBS_PTR_USDT to 1 (or configure CMake with OBS_PTR_USDT=ON) to emit SystemTap SDT probes
+//   under the provider "obs_ptr", which perf, bpftrace and friends attach to in a running process. Each probe is
+//   a single nop until attached. Requires <sys/sdt.h> (systemtap-sdt-dev), compilation fails without it.
+//
+// Hooks run on the thread doing the work. attach and detach run while the target's registry is locked, so they
+// must not attach or detach observers themselves. Every translation unit must agree on both settings.
+
+#ifndef OBS_PTR_USDT
+#define OBS_PTR_USDT 0
+#endif
+
+#if OBS_PTR_USDT
+#if !__has_include(<sys/sdt.h>)
+#error "OBS_PTR_USDT needs <sys/sdt.h> (systemtap-sdt-dev)"
+#endif
+#include <sys/sdt.h>
+#define OBS_PTR_PROBE1(name, a1) DTRACE_PROBE1(obs_ptr, name, a1)
+#define OBS_PTR_PROBE2(name, a1, a2) DTRACE_PROBE2(obs_ptr, name, a1, a2)
+#define OBS_PTR_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(obs_ptr, name, a1, a2, a3)
+#endif
+
+#ifndef OBS_PTR_PROBE1
+#define OBS_PTR_PROBE1(name, a1) ((void)0)
+#define OBS_PTR_PROBE2(name, a1, a2) ((void)0)
+#define OBS_PTR_PROBE3(name, a1, a2, a3) ((void)0)
+#endif
+
+// ========================
+// Forward Declarations
+// ========================
+class IObserved;
+class IObserver;
+
+// Default hook policy, does nothing
+struct obs_no_trace
+{
+    // observer registered with target, which now has observers registered
+    static void on_attach(const IObserved *, const IObserver *, std::size_t) noexcept
+    {
+    }
+
+    // observer unregistered from target, which now has observers registered
+    static void on_detach(const IObserved *, const IObserver *, std::size_t) noexcept
+    {
+    }
+
+    // target starts notifying its observers
+    static void on_notify_all(const IObserved *, std::size_t) noexcept
+    {
+    }
+
+    // target has notified all of its observers
+    static void on_notify_done(const IObserved *) noexcept
+    {
+    }
+
+    // observer is handling the destruction of its target, hasCallback tells whether it runs a callback
+    static void on_notification(const IObserver *, bool) noexcept
+    {
+    }
+};
+
+#ifdef OBS_PTR_TRACE_HOOKS_HEADER
+#include OBS_PTR_TRACE_HOOKS_HEADER
+#endif
+
+#ifndef OBS_PTR_TRACE_HOOKS
+#define OBS_PTR_TRACE_HOOKS obs_no_trace
+#endif
+
+// Tracepoints used by the library, forward to the hook policy and the USDT probes
+namespace obs_trace
+{
+using hooks = OBS_PTR_TRACE_HOOKS;
+
+inline void attach(const IObserved *pTarget, const IObserver *pObserver, std::size_t registrySize) noexcept
+{
+    hooks::on_attach(pTarget, pObserver, registrySize);
+    OBS_PTR_PROBE3(attach, pTarget, pObserver, registrySize);
+}
+
+inline void detach(const IObserved *pTarget, const IObserver *pObserver, std::size_t registrySize) noexcept
+{
+    hooks::on_detach(pTarget, pObserver, registrySize);
+    OBS_PTR_PROBE3(detach, pTarget, pObserver, registrySize);
+}
+
+inline void notify_all(const IObserved *pTarget, std::size_t observers) noexcept
+{
+    hooks::on_notify_all(pTarget, observers);
+    OBS_PTR_PROBE2(notify_all, pTarget, observers);
+}
+
+inline void notify_done(const IObserved *pTarget) noexcept
+{
+    hooks::on_notify_done(pTarget);
+    OBS_PTR_PROBE1(notify_done, pTarget);
+}
+
+inline void notification(const IObserver *pObserver, bool hasCallback) noexcept
+{
+    hooks::on_notification(pObserver, hasCallback);
+    OBS_PTR_PROBE2(notification, pObserver, static_cast<int>(hasCallback));
+}
+} // namespace obs_trace
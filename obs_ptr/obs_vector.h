@@ -0,0 +1,442 @@
+#pragma once
+
+// ========================
+// Standard Library Includes
+// ========================
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// ========================
+// Local Project Includes
+// ========================
+#include "IObserved.h"
+#include "IObserver.h"
+#include "notification_batch.h"
+#include "obs_sync.h"
+
+// ========================
+// Forward Declarations
+// ========================
+template <class T>
+class obs_vector;
+
+namespace obs_detail
+{
+// Entry of an obs_vector. Its index is the slot it lives in, so moving a registration between slots keeps it.
+template <class T>
+class vector_node : public IObserver
+{
+public:
+    vector_node(obs_vector<T> &owner, std::size_t index) noexcept
+        : m_pOwner(&owner), m_index(index)
+    {
+    }
+
+    vector_node(vector_node &&other) noexcept
+        : IObserver(other), m_pOwner(other.m_pOwner), m_index(other.m_index)
+    {
+        hook_guard guardOther(other);
+        hook_guard guard(*this);
+        move_from(other);
+    }
+
+    vector_node &operator=(vector_node &&other) noexcept
+    {
+        if (this != &other)
+        {
+            hook_guard guard(*this);
+            hook_guard guardOther(other);
+            unlink();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    ~vector_node()
+    {
+        if (!begin_teardown())
+        {
+            return;
+        }
+        hook_guard guard(*this, true);
+        unlink();
+    }
+
+    T *get() const noexcept
+    {
+        return static_cast<T *>(observed_link());
+    }
+
+    friend class IObserver;
+    friend class obs_vector<T>;
+
+protected:
+    void handle_notification() final
+    {
+        m_pOwner->mark_dead(m_index);
+    }
+
+private:
+    bool link(const std::shared_ptr<T> &spObserved)
+    {
+        hook_guard guard(*this);
+        return static_cast<IObserved &>(*spObserved).add_observer(*this);
+    }
+
+    void unlink()
+    {
+        if (auto pObserved = observed_link())
+        {
+            pObserved->remove_observer(*this);
+        }
+        notification_batch::cancel(*this);
+    }
+
+    void move_from(vector_node &other) noexcept
+    {
+        if (auto pObserved = other.observed_link())
+        {
+            pObserved->relocate_observer(other, *this);
+        }
+        notification_batch::relocate(other, *this);
+    }
+
+    obs_vector<T> *m_pOwner;
+    std::size_t m_index;
+};
+} // namespace obs_detail
+
+// Contiguous sequence of observed targets that drops each target when it is destroyed. Liveness is kept in a
+// bitmap the targets update as they die, so iteration skips dead entries a 64-bit word at a time and never
+// touches a reference count. Dead slots are reclaimed by compact(), which push_back runs once at least half
+// of the slots are dead, so compaction is amortized O(1) per insertion. Destroying the container detaches
+// from all remaining targets in one pass.
+//
+// Not copyable or movable, its entries point back at it. In thread-safe mode targets may die on other threads
+// while the container is read, but push_back, compact, clear and destruction must not race with them.
+template <class T>
+class obs_vector
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T *;
+        using reference = T &;
+
+        iterator() noexcept = default;
+
+        T &operator*() const noexcept
+        {
+            return *m_pVector->m_nodes[m_index].get();
+        }
+
+        T *operator->() const noexcept
+        {
+            return m_pVector->m_nodes[m_index].get();
+        }
+
+        iterator &operator++() noexcept
+        {
+            advance();
+            return *this;
+        }
+
+        iterator operator++(int) noexcept
+        {
+            iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const iterator &other) const noexcept
+        {
+            return m_index == other.m_index;
+        }
+
+        friend class obs_vector;
+
+    private:
+        // Walks the bitmap word by word, keeping the not yet visited bits of the current word
+        iterator(const obs_vector *pVector, std::size_t index) noexcept
+            : m_pVector(pVector), m_index(index)
+        {
+            if (index < pVector->m_nodes.size())
+            {
+                m_bits = load(pVector->m_pBits[0]);
+                advance();
+            }
+        }
+
+        void advance() noexcept
+        {
+            const std::size_t size = m_pVector->m_nodes.size();
+            for (;;)
+            {
+                while (m_bits != 0)
+                {
+                    const std::size_t index = m_word * 64 + static_cast<std::size_t>(std::countr_zero(m_bits));
+                    m_bits &= m_bits - 1;
+                    if (index >= size)
+                    {
+                        m_index = size;
+                        return;
+                    }
+                    // Skips entries whose notification a notification_batch still holds
+                    if (m_pVector->m_nodes[index].get() != nullptr)
+                    {
+                        m_index = index;
+                        return;
+                    }
+                }
+                if (++m_word * 64 >= size)
+                {
+                    m_index = size;
+                    return;
+                }
+                m_bits = load(m_pVector->m_pBits[m_word]);
+            }
+        }
+
+        const obs_vector *m_pVector = nullptr;
+        std::size_t m_index = 0;
+        std::size_t m_word = 0;
+        std::uint64_t m_bits = 0;
+    };
+
+    obs_vector() = default;
+
+    ~obs_vector()
+    {
+        clear();
+    }
+
+    obs_vector(const obs_vector &) = delete;
+    obs_vector &operator=(const obs_vector &) = delete;
+
+    // Appends spObserved. Returns false, storing nothing, if it is null or already being destroyed.
+    bool push_back(const std::shared_ptr<T> &spObserved)
+    {
+        if (spObserved == nullptr)
+        {
+            return false;
+        }
+        if (m_nodes.size() >= min_compact && dead() * 2 >= m_nodes.size())
+        {
+            compact();
+        }
+        const std::size_t index = m_nodes.size();
+        reserve_bits(index + 1);
+        m_nodes.emplace_back(*this, index);
+        // Live before linking, the target may die as soon as it is linked
+        set_live(index);
+        if (!m_nodes.back().link(spObserved))
+        {
+            clear_live(index);
+            m_nodes.pop_back();
+            return false;
+        }
+        return true;
+    }
+
+    // Moves the live entries to the front, in order, and frees the dead slots
+    void compact()
+    {
+        std::size_t out = 0;
+        for (std::size_t i = next_live(0); i < m_nodes.size(); i = next_live(i + 1))
+        {
+            if (i != out)
+            {
+                m_nodes[out] = std::move(m_nodes[i]);
+            }
+            out++;
+        }
+        m_nodes.erase(m_nodes.begin() + static_cast<std::ptrdiff_t>(out), m_nodes.end());
+        for (std::size_t w = 0; w < m_words; ++w)
+        {
+            const std::size_t first = w * 64;
+            const std::uint64_t bits = out >= first + 64 ? ~std::uint64_t{0} : out > first ? (std::uint64_t{1} << (out - first)) - 1 : 0;
+            store(m_pBits[w], bits);
+        }
+        store(m_dead, std::size_t{0});
+    }
+
+    // Detaches from every target
+    void clear()
+    {
+        m_nodes.clear();
+        for (std::size_t w = 0; w < m_words; ++w)
+        {
+            store(m_pBits[w], std::uint64_t{0});
+        }
+        store(m_dead, std::size_t{0});
+    }
+
+    // Number of live entries
+    std::size_t size() const noexcept
+    {
+        return m_nodes.size() - dead();
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    // Number of slots, live or dead, until the next compaction
+    std::size_t slots() const noexcept
+    {
+        return m_nodes.size();
+    }
+
+    iterator begin() const noexcept
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end() const noexcept
+    {
+        return iterator(this, m_nodes.size());
+    }
+
+    friend class obs_detail::vector_node<T>;
+
+private:
+    static constexpr std::size_t min_compact = 64;
+
+    template <class U>
+    static U load(const U &value) noexcept
+    {
+        if constexpr (obs_detail::thread_safe)
+        {
+            return std::atomic_ref<U>(const_cast<U &>(value)).load(std::memory_order_acquire);
+        }
+        else
+        {
+            return value;
+        }
+    }
+
+    template <class U>
+    static void store(U &target, U value) noexcept
+    {
+        if constexpr (obs_detail::thread_safe)
+        {
+            std::atomic_ref<U>(target).store(value, std::memory_order_release);
+        }
+        else
+        {
+            target = value;
+        }
+    }
+
+    std::size_t dead() const noexcept
+    {
+        return load(m_dead);
+    }
+
+    void set_live(std::size_t index) noexcept
+    {
+        auto &word = m_pBits[index / 64];
+        const std::uint64_t bit = std::uint64_t{1} << (index % 64);
+        if constexpr (obs_detail::thread_safe)
+        {
+            std::atomic_ref<std::uint64_t>(word).fetch_or(bit, std::memory_order_acq_rel);
+        }
+        else
+        {
+            word |= bit;
+        }
+    }
+
+    void clear_live(std::size_t index) noexcept
+    {
+        auto &word = m_pBits[index / 64];
+        const std::uint64_t bit = std::uint64_t{1} << (index % 64);
+        if constexpr (obs_detail::thread_safe)
+        {
+            std::atomic_ref<std::uint64_t>(word).fetch_and(~bit, std::memory_order_acq_rel);
+        }
+        else
+        {
+            word &= ~bit;
+        }
+    }
+
+    // Called from the notification of the entry in slot index
+    void mark_dead(std::size_t index) noexcept
+    {
+        clear_live(index);
+        if constexpr (obs_detail::thread_safe)
+        {
+            std::atomic_ref<std::size_t>(m_dead).fetch_add(1, std::memory_order_acq_rel);
+        }
+        else
+        {
+            m_dead++;
+        }
+    }
+
+    // First slot at or after from that is live, or size if none. An entry whose notification is still deferred
+    // by a notification_batch is already unlinked and skipped as well.
+    std::size_t next_live(std::size_t from) const noexcept
+    {
+        const std::size_t size = m_nodes.size();
+        for (std::size_t w = from / 64; w * 64 < size; ++w)
+        {
+            std::uint64_t bits = load(m_pBits[w]);
+            if (w == from / 64)
+            {
+                bits &= ~std::uint64_t{0} << (from % 64);
+            }
+            while (bits != 0)
+            {
+                const std::size_t index = w * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+                if (index >= size)
+                {
+                    return size;
+                }
+                if (m_nodes[index].get() != nullptr)
+                {
+                    return index;
+                }
+                bits &= bits - 1;
+            }
+        }
+        return size;
+    }
+
+    void reserve_bits(std::size_t slots)
+    {
+        const std::size_t words = (slots + 63) / 64;
+        if (words <= m_words)
+        {
+            return;
+        }
+        const std::size_t newWords = words > 2 * m_words ? words : 2 * m_words;
+        auto pBits = std::make_unique<std::uint64_t[]>(newWords);
+        for (std::size_t w = 0; w < m_words; ++w)
+        {
+            pBits[w] = load(m_pBits[w]);
+        }
+        m_pBits = std::move(pBits);
+        m_words = newWords;
+    }
+
+    std::vector<obs_detail::vector_node<T>> m_nodes;
+    // Bit i is set while slot i holds a live entry
+    std::unique_ptr<std::uint64_t[]> m_pBits;
+    std::size_t m_words = 0;
+    // Slots whose target died since the last compaction
+    std::size_t m_dead = 0;
+};
@@ -0,0 +1,162 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_pool.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace
+{
+struct PooledTarget : public IObserved
+{
+    PooledTarget() = default;
+
+    explicit PooledTarget(std::pmr::memory_resource *pResource)
+        : IObserved(pResource)
+    {
+    }
+};
+
+// Counts allocations passed on to the default resource
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    int allocations = 0;
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+} // namespace
+
+TEST(AllocatorObsTest, ObserversFromPool)
+{
+    CountingResource upstream;
+    obs_pool pool(obs_pool::node_size<obs_ptr<PooledTarget>>, 64, &upstream);
+    std::pmr::polymorphic_allocator<> alloc(&pool);
+
+    auto var = std::make_shared<PooledTarget>();
+    int calls = 0;
+    std::vector<obs_sptr<PooledTarget>> observers;
+    for (int i = 0; i < 64; ++i)
+    {
+        observers.push_back(make_observer<PooledTarget>(alloc, var, [&calls]()
+                                                        { calls++; }));
+    }
+    // A single chunk holds every observer
+    EXPECT_EQ(upstream.allocations, 1);
+    EXPECT_EQ(var->Observers(), 64);
+
+    // Freed blocks are reused
+    observers.clear();
+    for (int i = 0; i < 64; ++i)
+    {
+        observers.push_back(make_observer(alloc, var));
+    }
+    EXPECT_EQ(upstream.allocations, 1);
+
+    var.reset();
+    for (auto &ptr : observers)
+    {
+        EXPECT_EQ(ptr, nullptr);
+    }
+}
+
+TEST(AllocatorObsTest, RegistryUsesTargetResource)
+{
+    CountingResource resource;
+    auto var = std::make_shared<PooledTarget>(&resource);
+    EXPECT_EQ(var->observer_resource(), &resource);
+
+    // The registry was allocated up front
+    const int allocations = resource.allocations;
+    EXPECT_GT(allocations, 0);
+
+    std::vector<obs_ptr<PooledTarget>> observers;
+    observers.reserve(100);
+    observers.emplace_back(var);
+    EXPECT_EQ(var->observer_resource(), &resource);
+    for (int i = 1; i < 100; ++i)
+    {
+        observers.emplace_back(var);
+    }
+    // Growth allocates from the target's resource
+    EXPECT_GT(resource.allocations, allocations);
+    EXPECT_EQ(var->observer_resource(), &resource);
+
+    // The registry stays pinned without observers
+    for (auto &ptr : observers)
+    {
+        ptr.unset();
+    }
+    EXPECT_EQ(var->observer_resource(), &resource);
+    observers[0].set(var);
+    EXPECT_EQ(var->observer_resource(), &resource);
+
+    var.reset();
+    for (auto &ptr : observers)
+    {
+        EXPECT_EQ(ptr, nullptr);
+    }
+}
+
+TEST(AllocatorObsTest, MonotonicArena)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    auto var = std::make_shared<PooledTarget>(&arena);
+    auto spObserver = make_observer(std::pmr::polymorphic_allocator<>(&arena), var);
+    EXPECT_EQ(spObserver, var);
+    var.reset();
+    EXPECT_EQ(spObserver, nullptr);
+}
+
+TEST(AllocatorObsTest, RegistryOnlyWhileShared)
+{
+    static_assert(OBS_PTR_METRICS || sizeof(PooledTarget) == 2 * sizeof(void *),
+                  "An unobserved target should cost a vptr and one word");
+    CountingResource resource;
+    auto pPrevious = std::pmr::set_default_resource(&resource);
+    {
+        auto var = std::make_shared<PooledTarget>();
+        obs_ptr<PooledTarget> ptr1(var);
+        // A single observer is stored inline
+        EXPECT_EQ(resource.allocations, 0);
+        EXPECT_EQ(var->Observers(), 1);
+
+        obs_ptr<PooledTarget> ptr2(var);
+        EXPECT_GT(resource.allocations, 0);
+        EXPECT_EQ(var->Observers(), 2);
+
+        ptr1.unset();
+        ptr2.unset();
+        EXPECT_EQ(var->Observers(), 0);
+
+        // The block was released with the last observer, the first one is inline again
+        int allocations = resource.allocations;
+        ptr1.set(var);
+        EXPECT_EQ(resource.allocations, allocations);
+
+        int calls = 0;
+        obs_ptr<PooledTarget> ptr3(var, [&calls]()
+                                   { calls++; });
+        var.reset();
+        EXPECT_EQ(ptr1, nullptr);
+        EXPECT_EQ(ptr3, nullptr);
+        EXPECT_EQ(calls, 1);
+    }
+    std::pmr::set_default_resource(pPrevious);
+}
@@ -0,0 +1,168 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_await.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <coroutine>
+#include <deque>
+#include <memory>
+
+namespace
+{
+struct AwaitTarget : public IObserved
+{
+    int a = 0;
+};
+
+// Eagerly started coroutine that owns its frame until it finishes or is dropped
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object()
+        {
+            return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> h)
+        : handle(h)
+    {
+    }
+
+    Task(Task &&other) noexcept
+        : handle(std::exchange(other.handle, {}))
+    {
+    }
+
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    bool done() const
+    {
+        return handle.done();
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+struct QueueExecutor
+{
+    std::deque<std::coroutine_handle<>> *pQueue;
+
+    void operator()(std::coroutine_handle<> h) const
+    {
+        pQueue->push_back(h);
+    }
+};
+
+Task WaitFor(const obs_ptr<AwaitTarget> &ptr, int &resumed)
+{
+    co_await ptr.destroyed();
+    resumed++;
+}
+} // namespace
+
+TEST(AwaitObsTest, ResumesWhenTargetIsDestroyed)
+{
+    auto var = std::make_shared<AwaitTarget>();
+    obs_ptr<AwaitTarget> ptr(var);
+    int resumed = 0;
+    Task task = WaitFor(ptr, resumed);
+    EXPECT_EQ(resumed, 0);
+    EXPECT_EQ(var->Observers(), 2);
+
+    var.reset();
+    EXPECT_EQ(resumed, 1);
+    EXPECT_TRUE(task.done());
+}
+
+TEST(AwaitObsTest, AlreadyDestroyedDoesNotSuspend)
+{
+    obs_ptr<AwaitTarget> ptr;
+    int resumed = 0;
+    Task task = WaitFor(ptr, resumed);
+    EXPECT_EQ(resumed, 1);
+    EXPECT_TRUE(task.done());
+}
+
+TEST(AwaitObsTest, DroppedCoroutineUnregisters)
+{
+    auto var = std::make_shared<AwaitTarget>();
+    obs_ptr<AwaitTarget> ptr(var);
+    int resumed = 0;
+    {
+        Task task = WaitFor(ptr, resumed);
+        EXPECT_EQ(var->Observers(), 2);
+    }
+    EXPECT_EQ(var->Observers(), 1);
+    var.reset();
+    EXPECT_EQ(resumed, 0);
+}
+
+TEST(AwaitObsTest, FirstOfSeveral)
+{
+    auto var1 = std::make_shared<AwaitTarget>();
+    auto var2 = std::make_shared<AwaitTarget>();
+    auto var3 = std::make_shared<AwaitTarget>();
+    obs_ptr<AwaitTarget> ptr1(var1), ptr2(var2), ptr3(var3);
+    std::size_t first = 99;
+
+    auto waitAny = [&]() -> Task
+    {
+        first = co_await obs_first_destroyed(ptr1, ptr2, ptr3);
+    };
+    Task task = waitAny();
+
+    var2.reset();
+    EXPECT_EQ(first, 1);
+    EXPECT_TRUE(task.done());
+    // The other registrations went away with the finished co_await
+    EXPECT_EQ(var1->Observers(), 1);
+    EXPECT_EQ(var3->Observers(), 1);
+}
+
+TEST(AwaitObsTest, ResumesOnExecutor)
+{
+    std::deque<std::coroutine_handle<>> queue;
+    auto var = std::make_shared<AwaitTarget>();
+    obs_ptr<AwaitTarget> ptr(var);
+    int resumed = 0;
+
+    auto wait = [&]() -> Task
+    {
+        co_await ptr.destroyed(QueueExecutor{&queue});
+        resumed++;
+    };
+    Task task = wait();
+
+    var.reset();
+    EXPECT_EQ(resumed, 0);
+    ASSERT_EQ(queue.size(), 1);
+    queue.front().resume();
+    EXPECT_EQ(resumed, 1);
+    EXPECT_TRUE(task.done());
+}
@@ -188,6 +188,69 @@ TEST(BasicObsTest, Destruction)
     EXPECT_EQ(varRoot->Observers(), 0);
 }
 
+TEST(BasicObsTest, ManyObserversDetachInAnyOrder)
+{
+    auto var = std::make_shared<SimpleObsTargetTestClass>();
+    std::vector<obs_sptr<SimpleObsTargetTestClass>> observers;
+    for (int i = 0; i < 64; ++i)
+    {
+        observers.push_back(make_observer(var));
+    }
+    ASSERT_EQ(var->Observers(), 64);
+
+    // Remove from the front, the middle and the back, each removal relinks another observer
+    observers.erase(observers.begin());
+    observers.erase(observers.begin() + 20);
+    observers.pop_back();
+    observers[10]->unset();
+
+    EXPECT_EQ(var->Observers(), 60);
+    for (size_t i = 0; i < observers.size(); ++i)
+    {
+        EXPECT_EQ(var->IsObserver(observers[i]), i != 10);
+    }
+
+    var.reset();
+
+    for (auto &ptr : observers)
+    {
+        EXPECT_FALSE(ptr->is_set());
+    }
+}
+
+TEST(BasicObsTest, CallbacksMayChangeOtherObserversDuringDestruction)
+{
+    auto var = std::make_shared<SimpleObsTargetTestClass>();
+    auto other = std::make_shared<SimpleObsTargetTestClass>();
+    std::vector<obs_sptr<SimpleObsTargetTestClass>> observers;
+    for (int i = 0; i < 8; ++i)
+    {
+        observers.push_back(make_observer(var));
+    }
+    auto spOtherObserver = make_observer(other);
+    obs_sptr<SimpleObsTargetTestClass> spCopy;
+
+    int calls = 0;
+    auto spFirst = make_observer<SimpleObsTargetTestClass>(var, [&]()
+                                                           {
+        calls++;
+        // Destroy an observer that is still registered, copy another, and destroy an unrelated target
+        observers.front().reset();
+        spCopy = copy_observer(observers.back());
+        other.reset(); });
+
+    var.reset();
+    EXPECT_EQ(calls, 1);
+    // The copy was made from an observer of the dying target and starts unset
+    ASSERT_TRUE(spCopy.get() != nullptr);
+    EXPECT_FALSE(spCopy->is_set());
+    EXPECT_EQ(spOtherObserver, nullptr);
+    for (auto &ptr : observers)
+    {
+        EXPECT_TRUE(ptr == nullptr);
+    }
+}
+
 TEST(BasicObsTest, Copying)
 {
     auto ptr1 = make_observer<SimpleObsTargetTestClass>();
@@ -0,0 +1,72 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace
+{
+struct BulkTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+TEST(BulkObsTest, ObserveAll)
+{
+    auto var = std::make_shared<BulkTarget>();
+    obs_ptr<BulkTarget> single(var);
+    int calls = 0;
+    auto observers = observe_all(var, 1000, [&calls]()
+                                 { calls++; });
+    ASSERT_EQ(observers.size(), 1000);
+    EXPECT_EQ(var->Observers(), 1001);
+    for (auto &ptr : observers)
+    {
+        EXPECT_EQ(ptr, var);
+    }
+
+    // Registrations are ordinary ones afterwards
+    observers[10].unset();
+    observers.erase(observers.begin() + 500, observers.end());
+    EXPECT_EQ(var->Observers(), 500);
+
+    var.reset();
+    EXPECT_EQ(calls, 499);
+    EXPECT_EQ(single, nullptr);
+    for (auto &ptr : observers)
+    {
+        EXPECT_EQ(ptr, nullptr);
+    }
+}
+
+TEST(BulkObsTest, ObserveAllOfNothing)
+{
+    auto observers = observe_all<no_callback>(std::shared_ptr<BulkTarget>(), 3);
+    ASSERT_EQ(observers.size(), 3);
+    EXPECT_EQ(observers[0], nullptr);
+
+    auto var = std::make_shared<BulkTarget>();
+    auto one = observe_all<no_callback>(var, 1);
+    EXPECT_EQ(var->Observers(), 1);
+    EXPECT_EQ(one[0], var);
+}
+
+TEST(BulkObsTest, ObserveEach)
+{
+    std::vector<std::shared_ptr<BulkTarget>> targets;
+    for (int i = 0; i < 10; ++i)
+    {
+        targets.push_back(i == 3 ? nullptr : std::make_shared<BulkTarget>());
+    }
+    int calls = 0;
+    auto observers = observe_each(targets, [&calls]()
+                                  { calls++; });
+    ASSERT_EQ(observers.size(), targets.size());
+    for (std::size_t i = 0; i < targets.size(); ++i)
+    {
+        EXPECT_EQ(observers[i], targets[i]);
+    }
+    targets.clear();
+    EXPECT_EQ(calls, 9);
+}
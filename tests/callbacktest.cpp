@@ -0,0 +1,128 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_callback.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <functional>
+#include <memory>
+
+namespace
+{
+struct CallbackTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+static_assert(sizeof(obs_ptr<CallbackTarget, no_callback>) < sizeof(obs_ptr<CallbackTarget>),
+              "Observers without a callback should not store one");
+static_assert(!std::is_copy_constructible_v<obs_callback<>>);
+
+TEST(CallbackTest, MoveOnlyCapture)
+{
+    auto var = std::make_shared<CallbackTarget>();
+    auto spCalls = std::make_unique<int>(0);
+    int *pCalls = spCalls.get();
+    obs_ptr<CallbackTarget> ptr(var, [spCalls = std::move(spCalls)]()
+                                { (*spCalls)++; });
+
+    // Moving the observer moves the callback along
+    obs_ptr<CallbackTarget> moved(std::move(ptr));
+    var.reset();
+    EXPECT_EQ(*pCalls, 1);
+}
+
+TEST(CallbackTest, LargerCapacity)
+{
+    auto var = std::make_shared<CallbackTarget>();
+    std::array<int, 8> values{1, 2, 3, 4, 5, 6, 7, 8};
+    int sum = 0;
+    auto spObserver = make_observer<CallbackTarget, obs_callback<48>>(var, [values, &sum]()
+                                                                      {
+        for (int v : values)
+        {
+            sum += v;
+        } });
+    var.reset();
+    EXPECT_EQ(sum, 36);
+}
+
+TEST(CallbackTest, HeapFallback)
+{
+    struct ThrowingMove
+    {
+        ThrowingMove() = default;
+        ThrowingMove(ThrowingMove &&other) noexcept(false)
+            : pCalls(other.pCalls)
+        {
+        }
+
+        void operator()()
+        {
+            (*pCalls)++;
+        }
+
+        int *pCalls = nullptr;
+    };
+    struct alignas(32) OverAligned
+    {
+        void operator()()
+        {
+            (*pCalls)++;
+        }
+
+        int *pCalls = nullptr;
+    };
+
+    int calls = 0;
+    std::array<int, 16> values{};
+    values.fill(1);
+    auto large = [values, &calls]()
+    {
+        for (int v : values)
+        {
+            calls += v;
+        }
+    };
+    ThrowingMove throwing;
+    throwing.pCalls = &calls;
+    static_assert(!obs_callback<>::fits_inline<decltype(large)>);
+    static_assert(!obs_callback<>::fits_inline<ThrowingMove>);
+    static_assert(!obs_callback<>::fits_inline<OverAligned>);
+    static_assert(obs_callback<>::fits_inline<std::function<void()>>);
+
+    // Still usable by the default observer, as with std::function
+    auto var = std::make_shared<CallbackTarget>();
+    obs_ptr<CallbackTarget> first(var, large);
+    obs_ptr<CallbackTarget> second(var, std::move(throwing));
+    obs_ptr<CallbackTarget> third(var, OverAligned{&calls});
+    obs_ptr<CallbackTarget> moved(std::move(first));
+    var.reset();
+    EXPECT_EQ(calls, 18);
+}
+
+TEST(CallbackTest, EmptyStdFunctionIsNoCallback)
+{
+    obs_callback<> cb = std::function<void()>{};
+    EXPECT_FALSE(cb);
+
+    int calls = 0;
+    cb = std::function<void()>([&calls]()
+                               { calls++; });
+    ASSERT_TRUE(cb);
+    cb();
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(CallbackTest, NoCallbackObserver)
+{
+    auto var = std::make_shared<CallbackTarget>();
+    auto spObserver = make_observer<CallbackTarget, no_callback>(var);
+    auto spCopy = copy_observer(spObserver);
+    EXPECT_EQ(spCopy, var);
+    EXPECT_EQ(var->Observers(), 2);
+
+    var.reset();
+    EXPECT_EQ(spObserver, nullptr);
+    EXPECT_EQ(spCopy, nullptr);
+}
@@ -0,0 +1,93 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/notification_batch.h"
+#include "../obs_ptr/obs_compact.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace
+{
+struct CompactTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+static_assert(sizeof(obs_compact_ptr<CompactTarget>) <= 16);
+static_assert(sizeof(obs_compact_ptr<CompactTarget, no_callback>) <= 16);
+
+TEST(CompactObsTest, NullsAndCallsBack)
+{
+    int calls = 0;
+    auto var = std::make_shared<CompactTarget>();
+    obs_compact_ptr<CompactTarget> ptr(var, [&calls]()
+                                       { calls++; });
+    EXPECT_EQ(ptr, var);
+    EXPECT_EQ(var->Observers(), 1);
+    ptr->a = 5;
+    EXPECT_EQ(var->a, 5);
+
+    var.reset();
+    EXPECT_EQ(ptr, nullptr);
+    EXPECT_FALSE(ptr.is_set());
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(CompactObsTest, CopyAndMove)
+{
+    auto var1 = std::make_shared<CompactTarget>();
+    auto var2 = std::make_shared<CompactTarget>();
+    std::vector<obs_compact_ptr<CompactTarget>> ptrs;
+    for (int i = 0; i < 100; ++i)
+    {
+        // Reallocation moves them
+        ptrs.emplace_back(i % 2 == 0 ? var1 : var2);
+    }
+    EXPECT_EQ(var1->Observers(), 50);
+
+    obs_compact_ptr<CompactTarget> copy(ptrs[0]);
+    EXPECT_EQ(copy, var1);
+    EXPECT_EQ(var1->Observers(), 51);
+    copy = ptrs[1];
+    EXPECT_EQ(copy, var2);
+    EXPECT_EQ(var1->Observers(), 50);
+
+    obs_compact_ptr<CompactTarget> moved(std::move(ptrs[2]));
+    EXPECT_EQ(ptrs[2], nullptr);
+    EXPECT_EQ(moved, var1);
+    EXPECT_EQ(var1->Observers(), 50);
+
+    var1.reset();
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(ptrs[i].is_set(), i % 2 == 1);
+    }
+    EXPECT_EQ(moved, nullptr);
+
+    ptrs.clear();
+    EXPECT_EQ(var2->Observers(), 1);
+    copy.unset();
+    EXPECT_EQ(var2->Observers(), 0);
+}
+
+TEST(CompactObsTest, BatchedTeardown)
+{
+    int calls = 0;
+    auto var1 = std::make_shared<CompactTarget>();
+    auto var2 = std::make_shared<CompactTarget>();
+    obs_compact_ptr<CompactTarget> ptr(var1, [&calls]()
+                                       { calls++; });
+    obs_compact_ptr<CompactTarget, no_callback> bare(var1);
+    {
+        notification_batch batch;
+        var1.reset();
+        // Nulled immediately, the callback waits for the batch
+        EXPECT_EQ(ptr, nullptr);
+        EXPECT_EQ(bare, nullptr);
+        EXPECT_EQ(calls, 0);
+        ptr.set(var2);
+    }
+    EXPECT_EQ(calls, 1);
+    // Set again while the notification was pending, the new target is kept
+    EXPECT_EQ(ptr, var2);
+}
@@ -0,0 +1,222 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_hazard.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Only meaningful when the library is built with OBS_PTR_THREAD_SAFE, see obs_ptr_ts_tests
+#if OBS_PTR_THREAD_SAFE
+
+namespace
+{
+struct SharedTarget : public IObserved
+{
+    int a = 0;
+};
+
+constexpr int ThreadCount = 4;
+} // namespace
+
+TEST(ConcurrentObsTest, AttachDetachWhileTargetIsDestroyed)
+{
+    for (int round = 0; round < 50; ++round)
+    {
+        auto spTarget = std::make_shared<SharedTarget>();
+        std::weak_ptr<SharedTarget> wpTarget = spTarget;
+        obs_ptr<SharedTarget> seed(spTarget);
+        std::atomic<bool> start{false};
+        std::vector<std::vector<obs_ptr<SharedTarget>>> kept(ThreadCount);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < ThreadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+                                 {
+                while (!start.load())
+                {
+                }
+                for (int i = 0; i < 200; ++i)
+                {
+                    obs_ptr<SharedTarget> local(wpTarget.lock()); // The last owner may now be this thread
+                    obs_ptr<SharedTarget> copy = local;
+                    obs_ptr<SharedTarget> moved = std::move(copy);
+                    if (i % 10 == 0)
+                    {
+                        kept[t].push_back(std::move(moved));
+                    }
+                } });
+        }
+
+        start.store(true);
+        spTarget.reset();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+
+        EXPECT_FALSE(seed.is_set());
+        for (auto &observers : kept)
+        {
+            for (auto &observer : observers)
+            {
+                EXPECT_FALSE(observer.is_set());
+            }
+        }
+    }
+}
+
+TEST(ConcurrentObsTest, EveryObserverIsNotifiedOrDetachedOnce)
+{
+    constexpr int TargetCount = 64;
+    std::vector<std::shared_ptr<SharedTarget>> targets;
+    for (int i = 0; i < TargetCount; ++i)
+    {
+        targets.push_back(std::make_shared<SharedTarget>());
+    }
+
+    std::atomic<int> notified{0};
+    std::atomic<int> detached{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < ThreadCount; ++t)
+    {
+        // Each thread owns observers of every target and destroys them while the targets die
+        auto observers = std::make_shared<std::vector<obs_ptr<SharedTarget>>>();
+        for (auto &spTarget : targets)
+        {
+            observers->emplace_back(spTarget, [&notified]()
+                                    { notified++; });
+        }
+        threads.emplace_back([&, observers]()
+                             {
+            while (!start.load())
+            {
+            }
+            while (!observers->empty())
+            {
+                if (observers->back().is_set())
+                {
+                    detached++;
+                }
+                observers->pop_back();
+            } });
+    }
+
+    start.store(true);
+    targets.clear();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    // An observer seen as set may still be notified before it is destroyed, never the other way around
+    EXPECT_GE(notified + detached, TargetCount * ThreadCount);
+    EXPECT_LE(notified, TargetCount * ThreadCount);
+}
+
+TEST(ConcurrentObsTest, CallbackMayDestroyItsOwnObserver)
+{
+    auto spTarget = std::make_shared<SharedTarget>();
+    auto spObserver = std::make_shared<obs_ptr<SharedTarget>>();
+    spObserver->set(spTarget, [&spObserver]()
+                    { spObserver.reset(); });
+
+    std::thread destroyer([&spTarget]()
+                          { spTarget.reset(); });
+    destroyer.join();
+
+    EXPECT_EQ(spObserver, nullptr);
+}
+
+TEST(ConcurrentObsTest, CallbacksUnsetEachOther)
+{
+    for (int round = 0; round < 100; ++round)
+    {
+        auto spTarget1 = std::make_shared<SharedTarget>();
+        auto spTarget2 = std::make_shared<SharedTarget>();
+        obs_ptr<SharedTarget> first;
+        obs_ptr<SharedTarget> second;
+        std::atomic<int> calls{0};
+        // Both callbacks are running before either unsets the other, unless one was unset first
+        auto meet = [&calls]()
+        {
+            calls++;
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            while (calls.load() < 2 && std::chrono::steady_clock::now() < deadline)
+            {
+            }
+        };
+        first.set(spTarget1, [&]()
+                  { meet(); second.unset(); });
+        second.set(spTarget2, [&]()
+                   { meet(); first.unset(); });
+        std::atomic<bool> start{false};
+
+        std::thread destroyer1([&]()
+                               { while (!start.load()) {} spTarget1.reset(); });
+        std::thread destroyer2([&]()
+                               { while (!start.load()) {} spTarget2.reset(); });
+        start.store(true);
+        destroyer1.join();
+        destroyer2.join();
+
+        EXPECT_GE(calls.load(), 1);
+        EXPECT_FALSE(first.is_set());
+        EXPECT_FALSE(second.is_set());
+    }
+}
+
+TEST(ConcurrentObsTest, PinnedReadersWhileTargetIsDestroyed)
+{
+    struct CheckedTarget : public IObserved
+    {
+        ~CheckedTarget() override
+        {
+            alive.store(false);
+        }
+
+        std::atomic<bool> alive{true};
+    };
+
+    for (int round = 0; round < 50; ++round)
+    {
+        auto spTarget = make_observed<CheckedTarget>();
+        obs_ptr<CheckedTarget> shared(spTarget);
+        std::atomic<bool> start{false};
+        std::atomic<int> failures{0};
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < ThreadCount; ++t)
+        {
+            threads.emplace_back([&]()
+                                 {
+                while (!start.load())
+                {
+                }
+                for (int i = 0; i < 1000; ++i)
+                {
+                    if (auto pin = shared.pin())
+                    {
+                        if (!pin->alive.load())
+                        {
+                            failures++;
+                        }
+                    }
+                } });
+        }
+
+        start.store(true);
+        spTarget.reset();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        EXPECT_EQ(failures.load(), 0);
+        EXPECT_FALSE(shared.is_set());
+    }
+}
+
+#endif
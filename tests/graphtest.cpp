@@ -0,0 +1,156 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_graph.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+struct GraphTarget : public IObserved
+{
+    explicit GraphTarget(std::uint64_t id)
+        : id(id)
+    {
+    }
+
+    std::uint64_t id;
+};
+
+// Temporary file rewound for reading after writing
+struct TempFile
+{
+    TempFile()
+        : pFile(std::tmpfile())
+    {
+    }
+
+    ~TempFile()
+    {
+        std::fclose(pFile);
+    }
+
+    int fd() const
+    {
+        return fileno(pFile);
+    }
+
+    void rewind() const
+    {
+        lseek(fd(), 0, SEEK_SET);
+    }
+
+    std::FILE *pFile;
+};
+} // namespace
+
+TEST(GraphObsTest, SaveAndRelink)
+{
+    TempFile file;
+    constexpr int Targets = 5000;
+    constexpr int Observers = 20000;
+    {
+        std::vector<std::shared_ptr<GraphTarget>> targets;
+        std::vector<obs_ptr<GraphTarget>> observers(Observers);
+        obs_graph_writer writer(file.fd());
+        for (int i = 0; i < Targets; ++i)
+        {
+            targets.push_back(std::make_shared<GraphTarget>(1000 + i));
+            EXPECT_EQ(writer.add_target(*targets.back(), targets.back()->id), i);
+        }
+        for (int i = 0; i < Observers; ++i)
+        {
+            // Every seventh observer is left unset
+            if (i % 7 != 0)
+            {
+                observers[i].set(targets[(i * 31) % Targets]);
+            }
+            writer.add_observer(observers[i]);
+        }
+        writer.finish();
+    }
+
+    file.rewind();
+    obs_graph_reader reader(file.fd());
+    const auto &ids = reader.target_ids();
+    ASSERT_EQ(ids.size(), Targets);
+
+    std::vector<std::shared_ptr<GraphTarget>> targets;
+    for (auto id : ids)
+    {
+        targets.push_back(std::make_shared<GraphTarget>(id));
+    }
+    std::vector<obs_ptr<GraphTarget>> observers(Observers);
+    reader.relink_all(observers, targets);
+    EXPECT_TRUE(reader.at_end());
+
+    for (int i = 0; i < Observers; ++i)
+    {
+        if (i % 7 == 0)
+        {
+            EXPECT_FALSE(observers[i].is_set());
+        }
+        else
+        {
+            ASSERT_TRUE(observers[i].is_set());
+            EXPECT_EQ(observers[i]->id, 1000u + (i * 31) % Targets);
+        }
+    }
+}
+
+TEST(GraphObsTest, RejectsOtherData)
+{
+    TempFile file;
+    const char junk[] = "not a graph at all";
+    ASSERT_EQ(write(file.fd(), junk, sizeof(junk)), static_cast<ssize_t>(sizeof(junk)));
+    file.rewind();
+    EXPECT_THROW(obs_graph_reader reader(file.fd()), std::runtime_error);
+}
+
+TEST(GraphObsTest, LeavesFollowingDataUnread)
+{
+    TempFile file;
+    auto spTarget = std::make_shared<GraphTarget>(7);
+    obs_ptr<GraphTarget> observer(spTarget);
+    {
+        obs_graph_writer writer(file.fd());
+        writer.add_target(*spTarget, spTarget->id);
+        writer.add_observer(observer);
+        writer.finish();
+    }
+    const char tail[] = "next record";
+    ASSERT_EQ(write(file.fd(), tail, sizeof(tail)), static_cast<ssize_t>(sizeof(tail)));
+
+    file.rewind();
+    {
+        obs_graph_reader reader(file.fd());
+        EXPECT_EQ(reader.target_ids().size(), 1u);
+        obs_ptr<GraphTarget> loaded;
+        reader.relink(loaded, [&spTarget](std::uint32_t)
+                      { return spTarget; });
+        EXPECT_TRUE(reader.at_end());
+        EXPECT_EQ(loaded, spTarget);
+    }
+    // The reader stopped at the end of the graph
+    char readBack[sizeof(tail)] = {};
+    ASSERT_EQ(read(file.fd(), readBack, sizeof(readBack)), static_cast<ssize_t>(sizeof(tail)));
+    EXPECT_STREQ(readBack, tail);
+}
+
+TEST(GraphObsTest, UnfinishedWriterFlushes)
+{
+    TempFile file;
+    auto spTarget = std::make_shared<GraphTarget>(7);
+    {
+        obs_graph_writer writer(file.fd());
+        writer.add_target(*spTarget, spTarget->id);
+    }
+    EXPECT_GT(lseek(file.fd(), 0, SEEK_CUR), 0);
+
+    // Written out, but without its terminators
+    file.rewind();
+    obs_graph_reader reader(file.fd());
+    EXPECT_THROW(reader.target_ids(), std::runtime_error);
+}
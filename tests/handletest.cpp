@@ -0,0 +1,123 @@
+#include "../obs_ptr/obs_handle.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <cereal/archives/binary.hpp>
+#include <gtest/gtest.h>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+struct HandleTarget : public IHandleObserved<HandleTarget>
+{
+    int a = 0;
+};
+} // namespace
+
+static_assert(sizeof(obs_handle<HandleTarget>) == 8);
+static_assert(std::is_trivially_copyable_v<obs_handle<HandleTarget>>);
+
+TEST(HandleObsTest, InvalidatedOnDestruction)
+{
+    obs_handle<HandleTarget> handle;
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_FALSE(handle.is_set());
+
+    auto spTarget = std::make_unique<HandleTarget>();
+    spTarget->a = 3;
+    handle = spTarget->handle();
+    obs_handle<HandleTarget> copy = handle;
+    EXPECT_TRUE(handle.is_set());
+    EXPECT_EQ(handle->a, 3);
+    EXPECT_EQ(copy.get(), spTarget.get());
+    EXPECT_EQ(handle, copy);
+
+    spTarget.reset();
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_EQ(copy, nullptr);
+}
+
+TEST(HandleObsTest, ReusedSlotDoesNotRevive)
+{
+    auto spFirst = std::make_unique<HandleTarget>();
+    auto stale = spFirst->handle();
+    spFirst.reset();
+
+    // The freed slot is reused with a new generation
+    auto spSecond = std::make_unique<HandleTarget>();
+    auto fresh = spSecond->handle();
+    EXPECT_EQ(fresh.index(), stale.index());
+    EXPECT_NE(fresh.generation(), stale.generation());
+    EXPECT_EQ(stale, nullptr);
+    EXPECT_EQ(fresh.get(), spSecond.get());
+}
+
+TEST(HandleObsTest, LoadedUnknownIndexIsNull)
+{
+    auto spTarget = std::make_unique<HandleTarget>();
+    std::stringstream ss;
+    {
+        cereal::BinaryOutputArchive archive{ss};
+        // An index far beyond any slot handed out, as a corrupt or foreign archive may hold
+        archive(std::numeric_limits<std::uint32_t>::max() - 1, std::uint32_t{1});
+    }
+    obs_handle<HandleTarget> handle;
+    {
+        cereal::BinaryInputArchive archive{ss};
+        archive(handle);
+    }
+    EXPECT_EQ(handle.index(), std::numeric_limits<std::uint32_t>::max() - 1);
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_FALSE(handle.is_set());
+
+    obs_handle_watch<HandleTarget> watch(handle, []() {});
+    EXPECT_FALSE(watch.is_set());
+}
+
+TEST(HandleObsTest, ManyTargets)
+{
+    std::vector<std::unique_ptr<HandleTarget>> targets;
+    std::vector<obs_handle<HandleTarget>> handles;
+    for (int i = 0; i < 10000; ++i)
+    {
+        targets.push_back(std::make_unique<HandleTarget>());
+        targets.back()->a = i;
+        handles.push_back(targets.back()->handle());
+    }
+    for (int i = 0; i < 10000; i += 2)
+    {
+        targets[i].reset();
+    }
+    for (int i = 0; i < 10000; ++i)
+    {
+        EXPECT_EQ(handles[i].is_set(), i % 2 == 1);
+        if (i % 2 == 1)
+        {
+            EXPECT_EQ(handles[i]->a, i);
+        }
+    }
+}
+
+TEST(HandleObsTest, WatchRunsCallback)
+{
+    int calls = 0;
+    auto spTarget = std::make_shared<HandleTarget>();
+    obs_handle_watch<HandleTarget> watch(spTarget->handle(), [&calls]()
+                                         { calls++; });
+    obs_ptr<HandleTarget> ptr(spTarget);
+    EXPECT_TRUE(watch.is_set());
+    EXPECT_EQ(spTarget->Observers(), 2);
+
+    // Moving keeps the registration
+    std::vector<obs_handle_watch<HandleTarget>> watches;
+    watches.push_back(std::move(watch));
+    EXPECT_FALSE(watch.is_set());
+
+    spTarget.reset();
+    EXPECT_EQ(calls, 1);
+    EXPECT_FALSE(watches.front().is_set());
+    EXPECT_EQ(watches.front().handle(), nullptr);
+    EXPECT_EQ(ptr, nullptr);
+}
@@ -0,0 +1,63 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_hazard.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace
+{
+struct PinnedTarget : public IObserved
+{
+    explicit PinnedTarget(int *pDestroyed)
+        : pDestroyed(pDestroyed)
+    {
+    }
+
+    ~PinnedTarget() override
+    {
+        (*pDestroyed)++;
+    }
+
+    int *pDestroyed;
+    int a = 5;
+};
+} // namespace
+
+TEST(HazardObsTest, PinDefersDeletion)
+{
+    int destroyed = 0;
+    int calls = 0;
+    auto spTarget = make_observed<PinnedTarget>(&destroyed);
+    obs_ptr<PinnedTarget> ptr(spTarget, [&calls]()
+                              { calls++; });
+
+    auto pin = ptr.pin();
+    ASSERT_TRUE(pin);
+    EXPECT_EQ(pin.get(), spTarget.get());
+
+    spTarget.reset();
+    // Observers are nulled right away, the object itself outlives the pin
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(ptr, nullptr);
+    EXPECT_FALSE(ptr.pin());
+    EXPECT_EQ(destroyed, 0);
+    EXPECT_EQ(pin->a, 5);
+
+    pin.reset();
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(HazardObsTest, UnpinnedTargetIsDeletedImmediately)
+{
+    int destroyed = 0;
+    auto spTarget = make_observed<PinnedTarget>(&destroyed);
+    obs_ptr<PinnedTarget> ptr(spTarget);
+    {
+        auto pin = ptr.pin();
+        auto moved = std::move(pin);
+        EXPECT_FALSE(pin);
+        EXPECT_EQ(moved->a, 5);
+    }
+    spTarget.reset();
+    EXPECT_EQ(destroyed, 1);
+}
@@ -0,0 +1,145 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_mailbox.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct MailTarget : public IObserved
+{
+    int a = 0;
+};
+
+using HomedPtr = obs_ptr<MailTarget, obs_deliver_home>;
+} // namespace
+
+static_assert(sizeof(obs_ptr<MailTarget>) < sizeof(HomedPtr));
+
+TEST(MailboxTest, DeliversOnHomeThread)
+{
+    obs_mailbox mailbox;
+    std::thread::id calledOn;
+    int calls = 0;
+    auto var = std::make_shared<MailTarget>();
+    HomedPtr ptr(var, [&]()
+                 { calls++; calledOn = std::this_thread::get_id(); });
+    ptr.set_home(&mailbox);
+    EXPECT_EQ(ptr.home(), &mailbox);
+
+    std::thread([&var]()
+                { var.reset(); })
+        .join();
+    // Nulled immediately, the callback waits for the home thread
+    EXPECT_EQ(ptr, nullptr);
+    EXPECT_EQ(calls, 0);
+
+    EXPECT_EQ(mailbox.drain(), 1u);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(calledOn, std::this_thread::get_id());
+    EXPECT_EQ(mailbox.drain(), 0u);
+}
+
+TEST(MailboxTest, RunsInlineOnHomeThread)
+{
+    obs_mailbox mailbox;
+    int calls = 0;
+    auto var = std::make_shared<MailTarget>();
+    HomedPtr ptr(var, [&calls]()
+                 { calls++; });
+    ptr.set_home(&mailbox);
+
+    var.reset();
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(mailbox.drain(), 0u);
+}
+
+TEST(MailboxTest, DropsDestroyedAndUnsetObservers)
+{
+    obs_mailbox mailbox;
+    int calls = 0;
+    auto var1 = std::make_shared<MailTarget>();
+    auto var2 = std::make_shared<MailTarget>();
+    auto var3 = std::make_shared<MailTarget>();
+    auto pDestroyed = std::make_unique<HomedPtr>(var1, [&calls]()
+                                                 { calls++; });
+    HomedPtr unset(var2, [&calls]()
+                   { calls++; });
+    HomedPtr moved(var3, [&calls]()
+                   { calls += 10; });
+    pDestroyed->set_home(&mailbox);
+    unset.set_home(&mailbox);
+    moved.set_home(&mailbox);
+
+    std::thread([&]()
+                { var1.reset(); var2.reset(); var3.reset(); })
+        .join();
+    pDestroyed.reset();
+    unset.unset();
+    // The pending notification moves along with the callback and the home
+    HomedPtr target(std::move(moved));
+    EXPECT_EQ(target.home(), &mailbox);
+
+    EXPECT_EQ(mailbox.drain(), 1u);
+    EXPECT_EQ(calls, 10);
+}
+
+// Only meaningful when the library is built with OBS_PTR_THREAD_SAFE
+#if OBS_PTR_THREAD_SAFE
+TEST(MailboxTest, ManyProducers)
+{
+    constexpr int threads = 4;
+    constexpr int perThread = 2000;
+    obs_mailbox mailbox;
+    std::atomic<int> calls = 0;
+    std::vector<std::shared_ptr<MailTarget>> targets;
+    std::vector<HomedPtr> ptrs;
+    ptrs.reserve(threads * perThread);
+    for (int i = 0; i < threads * perThread; ++i)
+    {
+        targets.push_back(std::make_shared<MailTarget>());
+        ptrs.emplace_back(targets.back(), [&calls]()
+                          { calls++; });
+        ptrs.back().set_home(&mailbox);
+    }
+
+    std::atomic<bool> done = false;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t)
+    {
+        producers.emplace_back([&targets, t]()
+                               {
+            for (int i = t * perThread; i < (t + 1) * perThread; ++i)
+            {
+                targets[i].reset();
+            } });
+    }
+    // Drain while the producers post
+    std::size_t delivered = 0;
+    std::thread joiner([&]()
+                       { for (auto &producer : producers) { producer.join(); } done = true; });
+    // Unset every fourth observer meanwhile, before or after its notification is posted
+    for (std::size_t i = 0; i < ptrs.size(); i += 4)
+    {
+        ptrs[i].unset();
+        delivered += mailbox.drain();
+    }
+    while (!done)
+    {
+        delivered += mailbox.drain();
+    }
+    joiner.join();
+    delivered += mailbox.drain();
+
+    EXPECT_GE(delivered, static_cast<std::size_t>(threads * perThread * 3 / 4));
+    EXPECT_LE(delivered, static_cast<std::size_t>(threads * perThread));
+    EXPECT_EQ(calls, static_cast<int>(delivered));
+    for (auto &ptr : ptrs)
+    {
+        EXPECT_FALSE(ptr.is_set());
+    }
+}
+#endif
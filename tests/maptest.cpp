@@ -0,0 +1,134 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/notification_batch.h"
+#include "../obs_ptr/obs_map.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct MapTarget : public IObserved
+{
+    explicit MapTarget(int value)
+        : a(value)
+    {
+    }
+
+    int a;
+};
+} // namespace
+
+TEST(MapObsTest, ErasesOnDestruction)
+{
+    auto var1 = std::make_shared<MapTarget>(1);
+    auto var2 = std::make_shared<MapTarget>(2);
+    obs_map<MapTarget, std::string> map;
+    EXPECT_EQ(*map.try_emplace(var1, "one"), "one");
+    EXPECT_EQ(*map.try_emplace(var2, "two"), "two");
+    // Existing values are kept
+    EXPECT_EQ(*map.try_emplace(var1, "uno"), "one");
+    EXPECT_EQ(map.try_emplace(nullptr, "none"), nullptr);
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(var1->Observers(), 1);
+
+    const MapTarget *pVar1 = var1.get();
+    var1.reset();
+    EXPECT_EQ(map.size(), 1);
+    EXPECT_FALSE(map.contains(pVar1));
+    EXPECT_EQ(map.find(pVar1), nullptr);
+    EXPECT_EQ(*map.find(var2.get()), "two");
+
+    EXPECT_TRUE(map.erase(var2.get()));
+    EXPECT_FALSE(map.erase(var2.get()));
+    EXPECT_EQ(var2->Observers(), 0);
+    EXPECT_TRUE(map.empty());
+}
+
+TEST(MapObsTest, DetachesOnDestruction)
+{
+    std::vector<std::shared_ptr<MapTarget>> targets;
+    {
+        obs_map<MapTarget, int> map;
+        for (int i = 0; i < 10; ++i)
+        {
+            targets.push_back(std::make_shared<MapTarget>(i));
+            map.try_emplace(targets.back(), i);
+        }
+        EXPECT_EQ(targets[0]->Observers(), 1);
+    }
+    for (auto &spTarget : targets)
+    {
+        EXPECT_EQ(spTarget->Observers(), 0);
+    }
+}
+
+TEST(MapObsTest, BatchedTeardown)
+{
+    obs_map<MapTarget, int> map;
+    auto var = std::make_shared<MapTarget>(1);
+    map.try_emplace(var, 1);
+    {
+        notification_batch batch;
+        const MapTarget *pVar = var.get();
+        var.reset();
+        // Not found anymore, but only erased once the batch dispatches
+        EXPECT_EQ(map.find(pVar), nullptr);
+        EXPECT_EQ(map.size(), 1);
+
+        // A new target at the same address gets a new entry
+        auto other = std::make_shared<MapTarget>(2);
+        if (other.get() == pVar)
+        {
+            EXPECT_EQ(*map.try_emplace(other, 2), 2);
+        }
+    }
+    EXPECT_TRUE(map.empty());
+}
+
+TEST(CacheObsTest, EvictsLeastRecentlyUsed)
+{
+    std::vector<std::shared_ptr<MapTarget>> targets;
+    for (int i = 0; i < 4; ++i)
+    {
+        targets.push_back(std::make_shared<MapTarget>(i));
+    }
+    obs_cache<MapTarget, int> cache(3);
+    cache.try_emplace(targets[0], 0);
+    cache.try_emplace(targets[1], 1);
+    cache.try_emplace(targets[2], 2);
+    // 0 becomes the most recently used, so 1 is evicted
+    EXPECT_EQ(*cache.find(targets[0].get()), 0);
+    cache.try_emplace(targets[3], 3);
+    EXPECT_EQ(cache.size(), 3);
+    EXPECT_FALSE(cache.contains(targets[1].get()));
+    EXPECT_EQ(targets[1]->Observers(), 0);
+    EXPECT_TRUE(cache.contains(targets[0].get()));
+
+    // Destroyed targets are evicted right away
+    const MapTarget *pTarget = targets[2].get();
+    targets[2].reset();
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.find(pTarget), nullptr);
+
+    EXPECT_TRUE(cache.erase(targets[0].get()));
+    EXPECT_EQ(cache.size(), 1);
+    cache.clear();
+    EXPECT_TRUE(cache.empty());
+    EXPECT_EQ(targets[3]->Observers(), 0);
+}
+
+TEST(CacheObsTest, ValueDestroysOtherTarget)
+{
+    // Evicting an entry may destroy the target of another entry
+    obs_cache<MapTarget, std::shared_ptr<MapTarget>> cache(2);
+    auto var1 = std::make_shared<MapTarget>(1);
+    auto var2 = std::make_shared<MapTarget>(2);
+    cache.try_emplace(var1, std::move(var2));
+    auto *pVar2 = cache.find(var1.get())->get();
+    cache.try_emplace(*cache.find(var1.get()), nullptr);
+    EXPECT_EQ(cache.size(), 2);
+    var1.reset();
+    EXPECT_FALSE(cache.contains(pVar2));
+    EXPECT_TRUE(cache.empty());
+}
@@ -0,0 +1,70 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/notification_batch.h"
+#include "../obs_ptr/obs_metrics.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+// Only meaningful when the library is built with OBS_PTR_METRICS, see obs_ptr_instrumented_tests
+#if OBS_PTR_METRICS
+
+namespace
+{
+struct MeasuredTarget : public IObserved
+{
+    int a = 0;
+};
+
+std::uint64_t total(const std::array<std::uint64_t, obs_histogram_buckets> &histogram)
+{
+    return std::accumulate(histogram.begin(), histogram.end(), std::uint64_t{0});
+}
+} // namespace
+
+TEST(MetricsObsTest, CountsLifecycle)
+{
+    auto before = obs_metrics::snapshot();
+    {
+        auto var = std::make_shared<MeasuredTarget>();
+        int calls = 0;
+        std::vector<obs_ptr<MeasuredTarget>> observers;
+        observers.reserve(40);
+        for (int i = 0; i < 40; ++i)
+        {
+            observers.emplace_back(var, [&calls]()
+                                   { calls++; });
+        }
+        observers.pop_back();
+        observers.back().unset();
+        var.reset();
+        EXPECT_EQ(calls, 38);
+    }
+    auto after = obs_metrics::snapshot();
+
+    EXPECT_EQ(after.attaches - before.attaches, 40);
+    EXPECT_EQ(after.detaches - before.detaches, 2);
+    EXPECT_EQ(after.notifications - before.notifications, 38);
+    EXPECT_EQ(after.callbacks - before.callbacks, 38);
+    EXPECT_EQ(after.targets_destroyed - before.targets_destroyed, 1);
+    EXPECT_GE(after.peak_observers, 40);
+    // Peak of 40 lands in bucket [32, 64)
+    EXPECT_EQ(after.peak_observers_histogram[6] - before.peak_observers_histogram[6], 1);
+    EXPECT_EQ(total(after.teardown_ns_histogram) - total(before.teardown_ns_histogram), 1);
+}
+
+TEST(MetricsObsTest, CountsDeferred)
+{
+    auto before = obs_metrics::snapshot();
+    auto var = std::make_shared<MeasuredTarget>();
+    obs_ptr<MeasuredTarget> ptr(var);
+    {
+        notification_batch batch;
+        var.reset();
+    }
+    auto after = obs_metrics::snapshot();
+    EXPECT_EQ(after.deferred - before.deferred, 1);
+}
+
+#endif
@@ -0,0 +1,218 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/notification_batch.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct BatchTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+TEST(BatchObsTest, CallbacksRunAtScopeExit)
+{
+    int calls = 0;
+    std::vector<std::shared_ptr<BatchTarget>> targets;
+    std::vector<obs_ptr<BatchTarget>> observers;
+    observers.reserve(100);
+    for (int i = 0; i < 100; ++i)
+    {
+        targets.push_back(std::make_shared<BatchTarget>());
+        observers.emplace_back(targets.back(), [&calls]()
+                               { calls++; });
+    }
+
+    {
+        notification_batch batch;
+        targets.clear();
+        EXPECT_EQ(calls, 0);
+        EXPECT_EQ(batch.pending(), 100);
+        // Nulling is immediate
+        for (auto &observer : observers)
+        {
+            EXPECT_EQ(observer, nullptr);
+        }
+    }
+    EXPECT_EQ(calls, 100);
+}
+
+TEST(BatchObsTest, OneCallbackPerObserver)
+{
+    int calls = 0;
+    auto var1 = std::make_shared<BatchTarget>();
+    auto var2 = std::make_shared<BatchTarget>();
+    obs_ptr<BatchTarget> ptr(var1, [&calls]()
+                             { calls++; });
+    {
+        notification_batch batch;
+        var1.reset();
+        // Set again while the first notification is pending, then lose that target too
+        ptr.set(var2);
+        EXPECT_EQ(ptr, var2);
+        var2.reset();
+        EXPECT_EQ(batch.pending(), 1);
+    }
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(ptr, nullptr);
+}
+
+TEST(BatchObsTest, ResetObserverKeepsNewTarget)
+{
+    int calls = 0;
+    auto var1 = std::make_shared<BatchTarget>();
+    auto var2 = std::make_shared<BatchTarget>();
+    obs_ptr<BatchTarget> ptr(var1, [&calls]()
+                             { calls++; });
+    {
+        notification_batch batch;
+        var1.reset();
+        ptr.set(var2);
+    }
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(ptr, var2);
+    EXPECT_TRUE(ptr.is_set());
+}
+
+TEST(BatchObsTest, DestroyedOrUnsetObserversAreDropped)
+{
+    int calls = 0;
+    auto var = std::make_shared<BatchTarget>();
+    auto spDestroyed = make_observer<BatchTarget>(var, [&calls]()
+                                                  { calls++; });
+    obs_ptr<BatchTarget> unset(var, [&calls]()
+                               { calls++; });
+    obs_ptr<BatchTarget> kept(var, [&calls]()
+                              { calls += 10; });
+    {
+        notification_batch batch;
+        var.reset();
+        spDestroyed.reset();
+        unset.unset();
+        EXPECT_EQ(batch.pending(), 1);
+    }
+    EXPECT_EQ(calls, 10);
+}
+
+TEST(BatchObsTest, MovedObserverKeepsNotification)
+{
+    int calls = 0;
+    auto var = std::make_shared<BatchTarget>();
+    std::vector<obs_ptr<BatchTarget>> observers;
+    observers.emplace_back(var, [&calls]()
+                           { calls++; });
+    {
+        notification_batch batch;
+        var.reset();
+        // Reallocation moves the pending observer
+        for (int i = 0; i < 64; ++i)
+        {
+            observers.emplace_back();
+        }
+    }
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(BatchObsTest, NestedBatchesJoinOutermost)
+{
+    int calls = 0;
+    auto var1 = std::make_shared<BatchTarget>();
+    auto var2 = std::make_shared<BatchTarget>();
+    obs_ptr<BatchTarget> ptr1(var1, [&calls]()
+                              { calls++; });
+    obs_ptr<BatchTarget> ptr2(var2, [&calls]()
+                              { calls++; });
+    {
+        notification_batch outer;
+        {
+            notification_batch inner;
+            EXPECT_EQ(notification_batch::active(), &outer);
+            var1.reset();
+        }
+        EXPECT_EQ(calls, 0);
+        var2.reset();
+    }
+    EXPECT_EQ(notification_batch::active(), nullptr);
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(BatchObsTest, CallbackMayDestroyMoreTargets)
+{
+    int calls = 0;
+    auto var1 = std::make_shared<BatchTarget>();
+    auto var2 = std::make_shared<BatchTarget>();
+    auto spObserver = make_observer<BatchTarget>(var2, [&calls]()
+                                                 { calls++; });
+    obs_ptr<BatchTarget> ptr(var1, [&]()
+                             {
+                                 calls++;
+                                 var2.reset(); });
+    {
+        notification_batch batch;
+        var1.reset();
+    }
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(*spObserver, nullptr);
+}
+
+TEST(BatchObsTest, LongCascadeRunsIteratively)
+{
+    // Each callback destroys the next target in the chain. Run recursively this would need one teardown per
+    // link on the stack.
+    constexpr int links = 100000;
+    std::vector<std::shared_ptr<BatchTarget>> targets(links);
+    std::vector<obs_ptr<BatchTarget>> observers;
+    observers.reserve(links);
+    std::vector<int> order;
+    order.reserve(links);
+    for (int i = 0; i < links; ++i)
+    {
+        targets[i] = std::make_shared<BatchTarget>();
+        observers.emplace_back(targets[i], [&targets, &order, i]()
+                               {
+                                   order.push_back(i);
+                                   if (i + 1 < links)
+                                   {
+                                       targets[i + 1].reset();
+                                   } });
+    }
+    targets[0].reset();
+    ASSERT_EQ(order.size(), links);
+    for (int i = 0; i < links; ++i)
+    {
+        EXPECT_EQ(order[i], i);
+        EXPECT_EQ(observers[i], nullptr);
+    }
+}
+
+TEST(BatchObsTest, CascadeOrder)
+{
+    // root is observed by first, which destroys mid, and by last. mid is observed by two observers, the first
+    // of which destroys leaf. Cascaded notifications run in the order their targets died, after the
+    // notification that caused them and before the next one of the outer target.
+    std::vector<std::string> order;
+    auto root = std::make_shared<BatchTarget>();
+    auto mid = std::make_shared<BatchTarget>();
+    auto leaf = std::make_shared<BatchTarget>();
+    // Targets notify their most recently registered observer first
+    obs_ptr<BatchTarget> last(root, [&order]()
+                              { order.push_back("last"); });
+    obs_ptr<BatchTarget> first(root, [&order, &mid]()
+                               { order.push_back("first");
+                                 mid.reset();
+                                 order.push_back("first done"); });
+    obs_ptr<BatchTarget> mid2(mid, [&order]()
+                              { order.push_back("mid2"); });
+    obs_ptr<BatchTarget> mid1(mid, [&order, &leaf]()
+                              { order.push_back("mid1");
+                                leaf.reset(); });
+    obs_ptr<BatchTarget> leaf1(leaf, [&order, &mid2]()
+                               { order.push_back("leaf1");
+                                 EXPECT_EQ(mid2, nullptr); });
+    root.reset();
+    EXPECT_EQ(order, (std::vector<std::string>{"first", "first done", "mid1", "mid2", "leaf1", "last"}));
+}
@@ -0,0 +1,90 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_policy.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+namespace
+{
+struct PolicyTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+static_assert(std::is_same_v<obs_ptr<PolicyTarget>::callback_type, obs_callback<>>);
+static_assert(std::is_same_v<obs_ptr<PolicyTarget>::check_policy, obs_check_assert>);
+static_assert(std::is_same_v<obs_ptr<PolicyTarget>::storage_policy, obs_store_weak>);
+// Policies are found in any order, next to the callback type
+static_assert(std::is_same_v<obs_ptr<PolicyTarget, obs_store_link, no_callback, obs_check_throw>::callback_type, no_callback>);
+static_assert(std::is_same_v<obs_ptr<PolicyTarget, obs_store_link, no_callback, obs_check_throw>::check_policy, obs_check_throw>);
+static_assert(sizeof(obs_ptr<PolicyTarget, no_callback, obs_store_link>) + 2 * sizeof(void *) == sizeof(obs_ptr<PolicyTarget, no_callback>),
+              "Link-only observers should not store a weak_ptr");
+static_assert(noexcept(std::declval<obs_ptr<PolicyTarget>>().operator->()));
+static_assert(!noexcept(std::declval<obs_ptr<PolicyTarget, obs_check_throw>>().operator->()));
+
+TEST(PolicyTest, CheckThrow)
+{
+    auto var = std::make_shared<PolicyTarget>();
+    obs_ptr<PolicyTarget, obs_check_throw> ptr(var);
+    EXPECT_NO_THROW(ptr->a = 3);
+    var.reset();
+    EXPECT_THROW(ptr->a = 4, obs_bad_access);
+    EXPECT_THROW(*ptr, obs_bad_access);
+}
+
+TEST(PolicyTest, LinkStorage)
+{
+    auto var = std::make_shared<PolicyTarget>();
+    int calls = 0;
+    obs_ptr<PolicyTarget, obs_store_link, std::function<void()>> ptr(var, [&calls]()
+                                                                      { calls++; });
+    auto copy = ptr;
+    auto moved = std::move(ptr);
+    EXPECT_EQ(copy, var);
+    EXPECT_EQ(moved, var);
+    EXPECT_EQ(ptr, nullptr);
+    moved->a = 5;
+    EXPECT_EQ(var->a, 5);
+
+    var.reset();
+    EXPECT_EQ(copy, nullptr);
+    EXPECT_EQ(moved, nullptr);
+    // The copy does not take the callback
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(PolicyTest, MakeObserverWithPolicies)
+{
+    auto var = std::make_shared<PolicyTarget>();
+    bool called = false;
+    auto spObserver = make_observer<PolicyTarget, obs_check_none, obs_store_link>(var, [&called]()
+                                                                                  { called = true; });
+    auto spCopy = copy_observer(spObserver);
+    EXPECT_EQ(spCopy, var);
+    var.reset();
+    EXPECT_TRUE(called);
+    EXPECT_EQ(spCopy, nullptr);
+}
+
+TEST(PolicyTest, MixedPolicySetsShareTarget)
+{
+    auto var = std::make_shared<PolicyTarget>();
+    int calls = 0;
+    obs_ptr<PolicyTarget> ptr1(var, [&calls]()
+                               { calls += 1; });
+    obs_ptr<PolicyTarget, std::function<void()>, obs_store_link> ptr2(var, [&calls]()
+                                                                      { calls += 10; });
+    obs_ptr<PolicyTarget, no_callback> ptr3(var);
+    // Moved registrations keep notifying the right type of observer
+    auto moved = std::move(ptr2);
+    EXPECT_EQ(var->Observers(), 3);
+
+    var.reset();
+    EXPECT_EQ(calls, 11);
+    EXPECT_EQ(ptr1, nullptr);
+    EXPECT_EQ(moved, nullptr);
+    EXPECT_EQ(ptr3, nullptr);
+}
@@ -0,0 +1,71 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_ptr.h"
+#include "../obs_ptr/obs_shared.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace
+{
+struct SharedTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+TEST(SharedObsTest, CopiesShareOneRegistration)
+{
+    auto var = std::make_shared<SharedTarget>();
+    obs_shared<SharedTarget> handle(var);
+    std::vector<obs_shared<SharedTarget>> copies(500, handle);
+    EXPECT_EQ(var->Observers(), 1);
+    EXPECT_EQ(handle.use_count(), 501);
+    EXPECT_EQ(copies[499], var);
+    copies[0]->a = 3;
+    EXPECT_EQ(var->a, 3);
+
+    var.reset();
+    EXPECT_EQ(handle, nullptr);
+    for (auto &copy : copies)
+    {
+        EXPECT_FALSE(copy.is_set());
+    }
+}
+
+TEST(SharedObsTest, LastHandleUnregisters)
+{
+    auto var = std::make_shared<SharedTarget>();
+    obs_shared<SharedTarget> handle(var);
+    {
+        auto copy = handle;
+        auto moved = std::move(handle);
+        EXPECT_EQ(handle, nullptr);
+        EXPECT_EQ(handle.use_count(), 0);
+        EXPECT_EQ(moved.use_count(), 2);
+        EXPECT_EQ(var->Observers(), 1);
+    }
+    EXPECT_EQ(var->Observers(), 0);
+
+    obs_shared<SharedTarget> reset(var);
+    reset.reset();
+    EXPECT_EQ(var->Observers(), 0);
+    EXPECT_EQ(obs_shared<SharedTarget>(nullptr), nullptr);
+}
+
+TEST(SharedObsTest, SharesObserverTarget)
+{
+    int calls = 0;
+    auto var = std::make_shared<SharedTarget>();
+    auto spObserver = make_observer<SharedTarget>(var, [&calls]()
+                                                  { calls++; });
+    auto shared = share_observer(spObserver);
+    std::vector<obs_shared<SharedTarget>> copies(100, shared);
+    // The observer and one shared node
+    EXPECT_EQ(var->Observers(), 2);
+    EXPECT_EQ(copies[0], var);
+
+    var.reset();
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(copies[0], nullptr);
+    EXPECT_EQ(share_observer(spObserver), nullptr);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+class IObserved;
+class IObserver;
+
+// Hook policy the instrumented test build is compiled with, records what the library reports
+struct test_trace_hooks
+{
+    static inline thread_local std::size_t attaches = 0;
+    static inline thread_local std::size_t detaches = 0;
+    static inline thread_local std::size_t notifications = 0;
+    static inline thread_local std::size_t callbacks = 0;
+    static inline thread_local const IObserved *pLastTarget = nullptr;
+    static inline thread_local std::size_t lastTeardownSize = 0;
+    static inline thread_local const IObserved *pLastDone = nullptr;
+
+    static void on_attach(const IObserved *pTarget, const IObserver *, std::size_t) noexcept
+    {
+        pLastTarget = pTarget;
+        attaches++;
+    }
+
+    static void on_detach(const IObserved *, const IObserver *, std::size_t) noexcept
+    {
+        detaches++;
+    }
+
+    static void on_notify_all(const IObserved *pTarget, std::size_t observers) noexcept
+    {
+        pLastTarget = pTarget;
+        lastTeardownSize = observers;
+    }
+
+    static void on_notify_done(const IObserved *pTarget) noexcept
+    {
+        pLastDone = pTarget;
+    }
+
+    static void on_notification(const IObserver *, bool hasCallback) noexcept
+    {
+        notifications++;
+        callbacks += hasCallback ? 1 : 0;
+    }
+};
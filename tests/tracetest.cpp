@@ -0,0 +1,47 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_ptr.h"
+#include "../obs_ptr/obs_trace.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+// Only meaningful when the library is built with the test hooks, see obs_ptr_instrumented_tests
+#ifdef OBS_PTR_TRACE_HOOKS_HEADER
+
+namespace
+{
+struct TracedTarget : public IObserved
+{
+    int a = 0;
+};
+} // namespace
+
+TEST(TraceObsTest, HooksSeeLifecycle)
+{
+    auto attaches = test_trace_hooks::attaches;
+    auto detaches = test_trace_hooks::detaches;
+    auto notifications = test_trace_hooks::notifications;
+    auto callbacks = test_trace_hooks::callbacks;
+
+    auto var = std::make_shared<TracedTarget>();
+    const IObserved *pTarget = var.get();
+    int calls = 0;
+    obs_ptr<TracedTarget> ptr1(var, [&calls]()
+                               { calls++; });
+    obs_ptr<TracedTarget> ptr2(var);
+    obs_ptr<TracedTarget> ptr3(var);
+    EXPECT_EQ(test_trace_hooks::attaches - attaches, 3);
+    EXPECT_EQ(test_trace_hooks::pLastTarget, pTarget);
+
+    ptr3.unset();
+    EXPECT_EQ(test_trace_hooks::detaches - detaches, 1);
+
+    var.reset();
+    EXPECT_EQ(test_trace_hooks::lastTeardownSize, 2);
+    EXPECT_EQ(test_trace_hooks::pLastDone, pTarget);
+    EXPECT_EQ(test_trace_hooks::notifications - notifications, 2);
+    EXPECT_EQ(test_trace_hooks::callbacks - callbacks, 1);
+    EXPECT_EQ(calls, 1);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/obs_ptr.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace
+{
+struct ValueTarget : public IObserved
+{
+    int a = 0;
+};
+
+struct ValueOwner
+{
+    int notified = 0;
+    obs_ptr<ValueTarget> target;
+};
+} // namespace
+
+TEST(ValueObsTest, StackObserver)
+{
+    obs_ptr<ValueTarget> ptr;
+    EXPECT_EQ(ptr, nullptr);
+
+    {
+        auto var = std::make_shared<ValueTarget>();
+        ptr.set(var);
+        EXPECT_EQ(ptr, var);
+        EXPECT_EQ(var->Observers(), 1);
+    }
+    EXPECT_EQ(ptr, nullptr);
+    EXPECT_FALSE(ptr.is_set());
+}
+
+TEST(ValueObsTest, CopyRegistersWithoutCallback)
+{
+    auto var = std::make_shared<ValueTarget>();
+    int calls = 0;
+    obs_ptr<ValueTarget> orig(var, [&calls]()
+                              { calls++; });
+    obs_ptr<ValueTarget> copy = orig;
+
+    EXPECT_EQ(copy, var);
+    EXPECT_EQ(var->Observers(), 2);
+
+    obs_ptr<ValueTarget> assigned;
+    assigned = copy;
+    EXPECT_EQ(assigned, var);
+    EXPECT_EQ(var->Observers(), 3);
+
+    var.reset();
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(orig, nullptr);
+    EXPECT_EQ(copy, nullptr);
+    EXPECT_EQ(assigned, nullptr);
+}
+
+TEST(ValueObsTest, MoveRelocatesRegistration)
+{
+    auto var = std::make_shared<ValueTarget>();
+    int calls = 0;
+    obs_ptr<ValueTarget> orig(var, [&calls]()
+                              { calls++; });
+
+    obs_ptr<ValueTarget> moved(std::move(orig));
+    EXPECT_EQ(orig, nullptr);
+    EXPECT_EQ(moved, var);
+    EXPECT_EQ(var->Observers(), 1);
+
+    auto other = std::make_shared<ValueTarget>();
+    obs_ptr<ValueTarget> assigned(other);
+    assigned = std::move(moved);
+    EXPECT_EQ(moved, nullptr);
+    EXPECT_EQ(assigned, var);
+    EXPECT_EQ(var->Observers(), 1);
+    EXPECT_EQ(other->Observers(), 0);
+
+    var.reset();
+    EXPECT_EQ(calls, 1) << "Callback was not moved with the registration.";
+    EXPECT_EQ(assigned, nullptr);
+}
+
+TEST(ValueObsTest, ObserversInsideVector)
+{
+    auto var1 = std::make_shared<ValueTarget>();
+    auto var2 = std::make_shared<ValueTarget>();
+    std::vector<ValueOwner> owners;
+    for (int i = 0; i < 100; ++i)
+    {
+        // Growing the vector relocates every observer registered so far
+        owners.emplace_back();
+        owners.back().target.set(i % 2 ? var1 : var2);
+    }
+    EXPECT_EQ(var1->Observers(), 50);
+    EXPECT_EQ(var2->Observers(), 50);
+
+    owners.erase(owners.begin(), owners.begin() + 10);
+    EXPECT_EQ(var1->Observers(), 45);
+    EXPECT_EQ(var2->Observers(), 45);
+
+    var1.reset();
+    for (size_t i = 0; i < owners.size(); ++i)
+    {
+        EXPECT_EQ(owners[i].target.is_set(), i % 2 == 0);
+    }
+
+    owners.clear();
+    EXPECT_EQ(var2->Observers(), 0);
+}
+
+TEST(ValueObsTest, GetAndDereference)
+{
+    auto var = std::make_shared<ValueTarget>();
+    var->a = 7;
+    obs_ptr<ValueTarget> ptr(var);
+
+    EXPECT_EQ(ptr.get(), var.get());
+    EXPECT_EQ(ptr->a, 7);
+    (*ptr).a = 8;
+    EXPECT_EQ(var->a, 8);
+
+    var.reset();
+    EXPECT_EQ(ptr.get(), nullptr);
+    EXPECT_FALSE(ptr.is_set());
+}
@@ -0,0 +1,114 @@
+#include "../obs_ptr/IObserved.h"
+#include "../obs_ptr/notification_batch.h"
+#include "../obs_ptr/obs_vector.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace
+{
+struct VectorTarget : public IObserved
+{
+    explicit VectorTarget(int value)
+        : a(value)
+    {
+    }
+
+    int a;
+};
+
+std::vector<int> values(const obs_vector<VectorTarget> &vec)
+{
+    std::vector<int> result;
+    for (auto &target : vec)
+    {
+        result.push_back(target.a);
+    }
+    return result;
+}
+} // namespace
+
+TEST(VectorObsTest, SkipsDeadEntries)
+{
+    std::vector<std::shared_ptr<VectorTarget>> targets;
+    obs_vector<VectorTarget> vec;
+    for (int i = 0; i < 10; ++i)
+    {
+        targets.push_back(std::make_shared<VectorTarget>(i));
+        EXPECT_TRUE(vec.push_back(targets.back()));
+    }
+    EXPECT_FALSE(vec.push_back(nullptr));
+    EXPECT_EQ(vec.size(), 10);
+
+    targets[0].reset();
+    targets[4].reset();
+    targets[9].reset();
+    EXPECT_EQ(vec.size(), 7);
+    EXPECT_EQ(values(vec), (std::vector<int>{1, 2, 3, 5, 6, 7, 8}));
+
+    vec.compact();
+    EXPECT_EQ(vec.slots(), 7);
+    EXPECT_EQ(values(vec), (std::vector<int>{1, 2, 3, 5, 6, 7, 8}));
+
+    // Entries keep being dropped at their new slots
+    targets[5].reset();
+    EXPECT_EQ(values(vec), (std::vector<int>{1, 2, 3, 6, 7, 8}));
+}
+
+TEST(VectorObsTest, CompactsWhileGrowing)
+{
+    obs_vector<VectorTarget> vec;
+    std::vector<std::shared_ptr<VectorTarget>> keep;
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto var = std::make_shared<VectorTarget>(i);
+        vec.push_back(var);
+        if (i % 10 == 0)
+        {
+            keep.push_back(var);
+        }
+    }
+    // Nine out of ten targets died right away, so the slots never grow far past the live entries
+    EXPECT_EQ(vec.size(), 100);
+    EXPECT_LT(vec.slots(), 300);
+    std::size_t count = 0;
+    for (auto &target : vec)
+    {
+        EXPECT_EQ(target.a % 10, 0);
+        count++;
+    }
+    EXPECT_EQ(count, 100);
+}
+
+TEST(VectorObsTest, DetachesOnDestruction)
+{
+    auto var = std::make_shared<VectorTarget>(1);
+    {
+        obs_vector<VectorTarget> vec;
+        for (int i = 0; i < 100; ++i)
+        {
+            vec.push_back(var);
+        }
+        EXPECT_EQ(var->Observers(), 100);
+    }
+    EXPECT_EQ(var->Observers(), 0);
+}
+
+TEST(VectorObsTest, BatchedTeardown)
+{
+    obs_vector<VectorTarget> vec;
+    std::vector<std::shared_ptr<VectorTarget>> targets;
+    for (int i = 0; i < 5; ++i)
+    {
+        targets.push_back(std::make_shared<VectorTarget>(i));
+        vec.push_back(targets.back());
+    }
+    {
+        notification_batch batch;
+        targets.clear();
+        // Unlinked already, so not visited, but only counted dead once the batch dispatches
+        EXPECT_TRUE(values(vec).empty());
+    }
+    EXPECT_EQ(vec.size(), 0);
+    EXPECT_TRUE(vec.empty());
+}